@@ -0,0 +1,273 @@
+/*****************************************************************************
+ *
+ * @file kryptoBench.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Benchmark suite of the encryption engine: times key generation,
+ * encryption, the ANF kernels, parsing and writing of keys and ciphers
+ * and decryption over a grid of parameters (n, m, k, beta) with fixed
+ * seeds. Every case is warmed up and then repeated, the median, 95th
+ * percentile and minimum are reported on the console and written as
+ * JSON for regression checks.
+ *
+ * Usage: kryptoBench [-quick] [-r REPETITIONS=5] [-o JSONFILE]
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+
+#include "../src/functionParser.h"
+using namespace functionParser;
+
+#include "../src/kryptoSAT.h"
+
+using namespace kryptoSAT;
+
+
+/// one point of the parameter grid
+struct benchConfig{
+  size_t n;
+  size_t m;
+  unsigned int k;
+  size_t beta;
+};
+
+/// timings of one case in ms
+struct benchResult{
+  string name;
+  benchConfig config;
+  size_t repetitions;
+  double median;
+  double p95;
+  double min;
+};
+
+
+/// Runs f warmup times untimed, then repetitions times timed. The
+/// engine's console output is suppressed meanwhile.
+benchResult measure(const string& name, const benchConfig& config, size_t warmup, size_t repetitions, const function<void()>& f){
+  streambuf* console = cout.rdbuf(0);
+  for(size_t i=0;i<warmup;i++){
+    f();
+  }
+  vector<double> times;
+  for(size_t i=0;i<repetitions;i++){
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    f();
+    times.push_back(chrono::duration<double,milli>(chrono::steady_clock::now()-start).count());
+  }
+  cout.rdbuf(console);
+
+  sort(times.begin(),times.end());
+  benchResult re;
+  re.name=name;
+  re.config=config;
+  re.repetitions=repetitions;
+  re.median = times.size()%2==1 ? times[times.size()/2] : (times[times.size()/2-1]+times[times.size()/2])/2;
+  re.p95 = times[(size_t)(0.95*(times.size()-1)+0.5)];
+  re.min = times[0];
+
+  cout << name << "\tn=" << config.n << " m=" << config.m << " k=" << config.k << " beta=" << config.beta
+       << "\tmedian " << re.median << " ms\tp95 " << re.p95 << " ms\tmin " << re.min << " ms" << endl;
+  return re;
+}
+
+
+/// All cases for one configuration, appended to results.
+void benchmark(const benchConfig& c, size_t repetitions, vector<benchResult>& results){
+  const size_t keySeed=4242;
+  const size_t salt=777;
+  mersenneTwisterRNG prototype;
+
+  //key generation
+  bool* privateKey=0;
+  results.push_back(measure("generatePrivateKey",c,1,repetitions,[&](){
+        delete[] privateKey;
+        privateKey = generatePrivateKey(&prototype,keySeed,c.n);
+      }));
+  flatCNF* publicKey=0;
+  results.push_back(measure("generatePublicKey",c,1,repetitions,[&](){
+        delete publicKey;
+        publicKey = generatePublicKey(&prototype,keySeed,privateKey,c.n,c.m,c.k,1);
+      }));
+
+  //encryption of a single bit, with the key prepared once
+  preparedPublicKey key(publicKey,c.n);
+  flatANF cipher;
+  rng* r = spawnEncoderRNG(&prototype,ENCODERVERSION);
+  results.push_back(measure("preparePublicKey",c,1,repetitions,[&](){
+        preparedPublicKey p(publicKey,c.n);
+      }));
+  results.push_back(measure("encrypt",c,1,repetitions,[&](){
+        r->seed(salt,0);
+        encrypt(r,key,true,c.beta,cipher,ENCODERVERSION,1);
+      }));
+
+  //kernels on the variables of a window: (beta-1)*k variables, one negated clause
+  vector<unsigned int> variables;
+  for(unsigned int v=1;v<=(c.beta-1)*c.k;v++){
+    variables.push_back(v);
+  }
+  flatANF R;
+  results.push_back(measure("RandomFunction",c,10,100*repetitions,[&](){
+        R = RandomFunction(r,variables);
+      }));
+  results.push_back(measure("RandomFunctionBits",c,10,100*repetitions,[&](){
+        R = RandomFunctionBits(r,variables);
+      }));
+  results.push_back(measure("multiplyToANF",c,10,100*repetitions,[&](){
+        flatANF product = R.clone();
+        multiplyToANF(product,key.getNegatedClauses(),key.negatedBegin(0),key.negatedEnd(0));
+      }));
+  results.push_back(measure("sortANF",c,1,repetitions,[&](){
+        flatANF g = cipher.clone();
+        sortANF(g,true);
+      }));
+
+  //text formats
+  stringstream cnfText;
+  writeCNF(cnfText,publicKey);
+  string cnf = cnfText.str();
+  results.push_back(measure("writeCNF",c,1,repetitions,[&](){
+        stringstream out;
+        writeCNF(out,publicKey);
+      }));
+  results.push_back(measure("readCNF",c,1,repetitions,[&](){
+        stringstream in(cnf);
+        delete readCNF(in);
+      }));
+  stringstream anfText;
+  writeANF(anfText,cipher,c.n);
+  string anf = anfText.str();
+  results.push_back(measure("writeANF",c,1,repetitions,[&](){
+        stringstream out;
+        writeANF(out,cipher,c.n);
+      }));
+  results.push_back(measure("readANF",c,1,repetitions,[&](){
+        stringstream in(anf);
+        flatANF f;
+        size_t nbrVars;
+        readANF(in,f,nbrVars);
+      }));
+
+  //decryption
+  packedKey packed(privateKey,c.n);
+  results.push_back(measure("decrypt",c,1,repetitions,[&](){
+        if(!evaluate(packed,cipher)){
+          cerr << "ERR: decryption failed." << endl;
+        }
+      }));
+
+  delete r;
+  delete publicKey;
+  delete[] privateKey;
+}
+
+
+bool writeJSON(const string& file, const vector<benchResult>& results){
+  ofstream out(file.c_str());
+  if(!out.good()){
+    cerr << "ERR: could not open file " << file << " for writing." << endl;
+    return false;
+  }
+  out << "{\n  \"encoderVersion\": " << ENCODERVERSION << ",\n  \"results\": [\n";
+  for(size_t i=0;i<results.size();i++){
+    const benchResult& b = results[i];
+    out << "    {\"name\": \"" << b.name << "\", \"n\": " << b.config.n << ", \"m\": " << b.config.m
+        << ", \"k\": " << b.config.k << ", \"beta\": " << b.config.beta
+        << ", \"repetitions\": " << b.repetitions << ", \"median_ms\": " << b.median
+        << ", \"p95_ms\": " << b.p95 << ", \"min_ms\": " << b.min << "}"
+        << (i+1<results.size() ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+  return out.good();
+}
+
+
+int main(int argc, char** argv){
+  bool quick=false;
+  size_t repetitions=5;
+  string outFile="bench.json";
+  for(int i=1;i<argc;i++){
+    if(strcmp(argv[i],"-quick")==0){
+      quick=true;
+    }else if(strcmp(argv[i],"-r")==0 && i+1<argc){
+      repetitions=atol(argv[++i]);
+    }else if(strcmp(argv[i],"-o")==0 && i+1<argc){
+      outFile=argv[++i];
+    }else{
+      cout << "kryptoBench [-quick] [-r REPETITIONS=5] [-o JSONFILE=bench.json]" << endl;
+      return 1;
+    }
+  }
+  if(repetitions<1){
+    repetitions=1;
+  }
+
+  vector<benchConfig> grid;
+  grid.push_back(benchConfig{64,5*64,3,3});
+  grid.push_back(benchConfig{256,5*256,3,3});
+  if(!quick){
+    grid.push_back(benchConfig{256,5*256,4,3});
+    grid.push_back(benchConfig{256,5*256,3,4});
+    grid.push_back(benchConfig{1024,5*1024,3,3});
+  }
+
+  vector<benchResult> results;
+  for(size_t i=0;i<grid.size();i++){
+    benchmark(grid[i],repetitions,results);
+  }
+
+  if(!writeJSON(outFile,results)){
+    return 1;
+  }
+  cout << "Wrote " << results.size() << " results to " << outFile << endl;
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*****************************************************************************
+ *
+ * @file rngBench.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Micro-benchmark of the random number generators: raw output,
+ * random bits and bounded integers per second of the Mersenne Twister
+ * and the ChaCha20 generator, each plain and behind the pooledRNG
+ * front end.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+#include <iostream>
+#include <chrono>
+#include <string>
+
+using namespace std;
+
+#include "../src/rng.h"
+#include "../src/chachaRNG.h"
+
+
+/// results end up here, so that the draws can not be optimised away
+volatile size_t sink;
+
+/// seconds since start
+double elapsed(const chrono::steady_clock::time_point& start){
+  return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+/// bytes of randomBits() per second
+double byteRate(rng* r, size_t nbr){
+  size_t x=0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for(size_t i=0;i<nbr;i++){
+    x ^= r->randomBits();
+  }
+  double t = elapsed(start);
+  sink = x;
+  return 8*nbr/t;
+}
+
+/// randomBool() calls per second
+double boolRate(rng* r, size_t nbr){
+  size_t x=0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for(size_t i=0;i<nbr;i++){
+    x += r->randomBool();
+  }
+  double t = elapsed(start);
+  sink = x;
+  return nbr/t;
+}
+
+/// randomInt(max) calls per second for varying small bounds, as
+/// drawn by the permutations
+double intRate(rng* r, size_t nbr){
+  size_t x=0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for(size_t i=0;i<nbr;i++){
+    x += r->randomInt(5120-(i%5120));
+  }
+  double t = elapsed(start);
+  sink = x;
+  return nbr/t;
+}
+
+void report(const string& name, rng* r, size_t nbr){
+  r->seed(42,0);
+  double bytes = byteRate(r,nbr/8);
+  double bits = boolRate(r,nbr);
+  double ints = intRate(r,nbr);
+  cout << name << "\t" << bytes/1e6 << " MB/s\t" << bits/1e6 << " Mbit/s\t" << ints/1e6 << " Mint/s" << endl;
+}
+
+
+int main(int argc, char** argv){
+  size_t nbr = argc>1 ? stoull(argv[1]) : 50000000;
+
+  cout << "Drawing " << nbr << " booleans and bounded integers per generator" << endl;
+
+  rng* plain = new mersenneTwisterRNG();
+  report("mersenneTwisterRNG",plain,nbr);
+  delete plain;
+
+  rng* pooled = new pooledRNG(new mersenneTwisterRNG());
+  report("pooledRNG(MT)",pooled,nbr);
+  delete pooled;
+
+  rng* chacha = new chachaRNG();
+  report("chachaRNG",chacha,nbr);
+  delete chacha;
+
+  rng* pooledChacha = new pooledRNG(new chachaRNG());
+  report("pooledRNG(ChaCha)",pooledChacha,nbr);
+  delete pooledChacha;
+
+  return 0;
+}
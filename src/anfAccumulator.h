@@ -0,0 +1,271 @@
+/*****************************************************************************
+ *
+ * @file anfAccumulator.h
+ *
+ * @section DESCRIPTION
+ *
+ * Hash based accumulator for sums (XOR) of many monomials. Inserting a
+ * monomial toggles its membership, hence pairs cancel immediately and
+ * the memory tracks the size of the live sum instead of the number of
+ * summands.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+#ifndef ANFACCUMULATOR_H
+#define ANFACCUMULATOR_H
+
+#include <vector>
+
+#include "flatANF.h"
+
+
+
+/// Open addressing (linear probing) hash set of monomials, keyed on
+/// their contents, where insertion toggles membership. Removed
+/// monomials leave dead space in the arena, which is compacted as
+/// soon as it outweighs the live monomials.
+class anfAccumulator{
+
+ protected:
+
+  struct entry{
+    size_t start;
+    unsigned int length;
+    bool alive;
+  };
+
+  /// the hash is kept in the table, so that probing does not need to
+  /// touch the entries of non matching monomials
+  struct slot{
+    unsigned long long hash;
+    /// index+1 into entries, 0 marks an empty slot
+    size_t entry;
+  };
+
+  /// variable numbers of all stored monomials
+  vector<unsigned int> arena;
+  vector<entry> entries;
+  vector<slot> table;
+
+  size_t liveMonomials;
+  size_t liveWords;
+  size_t deadWords;
+
+
+  static unsigned long long hashMonomial(const unsigned int* begin, const unsigned int* end){
+    unsigned long long h = 0x9E3779B97F4A7C15ULL ^ (unsigned long long)(end-begin);
+    for(const unsigned int* v=begin;v!=end;v++){
+      h = (h ^ *v) * 0xFF51AFD7ED558CCDULL;
+      h ^= h >> 32;
+    }
+    h ^= h >> 29;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 32;
+    return h;
+  }
+
+  size_t mask() const{return table.size()-1;}
+
+  bool equals(const entry& e, const unsigned int* begin, const unsigned int* end) const{
+    return e.length==(size_t)(end-begin) && equal(begin,end,arena.begin()+e.start);
+  }
+
+  /// put s into the table, no checks
+  void place(const slot& s){
+    size_t i = s.hash & mask();
+    while(table[i].entry!=0){
+      i = (i+1) & mask();
+    }
+    table[i]=s;
+  }
+
+  /// rebuild the table with tableSize slots
+  void rehash(size_t tableSize){
+    vector<slot> old;
+    old.swap(table);
+    slot empty = {0,0};
+    table.assign(tableSize,empty);
+    for(size_t i=0;i<old.size();i++){
+      if(old[i].entry!=0){
+        place(old[i]);
+      }
+    }
+  }
+
+  /// backward shift deletion, keeps all probe sequences intact
+  void removeSlot(size_t pos){
+    size_t i=pos;
+    size_t j=pos;
+    while(true){
+      j=(j+1) & mask();
+      if(table[j].entry==0){
+        break;
+      }
+      size_t home = table[j].hash & mask();
+      //move table[j] to the hole at i, if its home is not in (i,j] (cyclically)
+      bool inBetween = (i<=j) ? (i<home && home<=j) : (i<home || home<=j);
+      if(!inBetween){
+        table[i]=table[j];
+        i=j;
+      }
+    }
+    table[i].entry=0;
+  }
+
+  /// drop the space of removed monomials
+  void compact(){
+    vector<unsigned int> newArena;
+    newArena.reserve(liveWords);
+    vector<entry> newEntries;
+    newEntries.reserve(liveMonomials);
+    vector<size_t> old2new(entries.size());
+    for(size_t i=0;i<entries.size();i++){
+      if(entries[i].alive){
+        entry e = entries[i];
+        e.start = newArena.size();
+        newArena.insert(newArena.end(),arena.begin()+entries[i].start,arena.begin()+entries[i].start+entries[i].length);
+        old2new[i]=newEntries.size();
+        newEntries.push_back(e);
+      }
+    }
+    arena.swap(newArena);
+    entries.swap(newEntries);
+    deadWords=0;
+    //slot positions only depend on the hashes, hence in place renumbering suffices
+    for(size_t i=0;i<table.size();i++){
+      if(table[i].entry!=0){
+        table[i].entry=old2new[table[i].entry-1]+1;
+      }
+    }
+  }
+
+
+ public:
+
+  anfAccumulator():liveMonomials(0),liveWords(0),deadWords(0){
+    clear();
+  }
+
+  /// number of monomials currently in the sum
+  size_t size() const{return liveMonomials;}
+
+  /// add (XOR) the monomial [begin,end), which has to be sorted
+  void toggle(const unsigned int* begin, const unsigned int* end){
+    unsigned long long h = hashMonomial(begin,end);
+    size_t pos = h & mask();
+    while(table[pos].entry!=0){
+      if(table[pos].hash==h && equals(entries[table[pos].entry-1],begin,end)){
+        //cancels
+        entry& e = entries[table[pos].entry-1];
+        e.alive=false;
+        liveMonomials--;
+        liveWords-=e.length;
+        deadWords+=e.length;
+        removeSlot(pos);
+        if(deadWords > liveWords + 4096 || entries.size() > 2*liveMonomials + 1024){
+          compact();
+        }
+        return;
+      }
+      pos = (pos+1) & mask();
+    }
+
+    entry e;
+    e.start=arena.size();
+    e.length=end-begin;
+    e.alive=true;
+    arena.insert(arena.end(),begin,end);
+    entries.push_back(e);
+    table[pos].hash=h;
+    table[pos].entry=entries.size();
+    liveMonomials++;
+    liveWords+=e.length;
+
+    //load factor <= 1/2
+    if(2*liveMonomials > table.size()){
+      rehash(2*table.size());
+    }
+  }
+
+  /// add (XOR) all monomials of f, which have to be sorted individually
+  void toggle(const flatANF& f){
+    for(size_t i=0;i<f.size();i++){
+      toggle(f.monomialBegin(i),f.monomialEnd(i));
+    }
+  }
+
+  /// add (XOR) all monomials of the sum f
+  void toggle(const anfAccumulator& f){
+    for(size_t i=0;i<f.entries.size();i++){
+      if(f.entries[i].alive){
+        toggle(f.arena.data()+f.entries[i].start,f.arena.data()+f.entries[i].start+f.entries[i].length);
+      }
+    }
+  }
+
+  /// Replace g by the accumulated sum. If sorted, g is in canonical
+  /// order (as after sortANF), otherwise in no particular order.
+  void extract(flatANF& g, bool sorted=true) const{
+    g.clear();
+    g.reserve(liveMonomials,liveWords);
+    for(size_t i=0;i<entries.size();i++){
+      if(entries[i].alive){
+        g.addMonomial(arena.data()+entries[i].start,arena.data()+entries[i].start+entries[i].length);
+      }
+    }
+    if(sorted){
+      g.sort(false);
+    }
+  }
+
+  /// empty the sum and release its memory
+  void clear(){
+    vector<unsigned int>().swap(arena);
+    vector<entry>().swap(entries);
+    slot empty = {0,0};
+    vector<slot>(1024,empty).swap(table);
+    liveMonomials=0;
+    liveWords=0;
+    deadWords=0;
+  }
+
+};
+
+
+#endif
@@ -0,0 +1,217 @@
+/*****************************************************************************
+ *
+ * @file batch.h
+ *
+ * @section DESCRIPTION
+ *
+ * Batch encryption of many clear texts under one public key. The key
+ * is prepared once and all bits of all messages are scheduled onto one
+ * pool of threads with work stealing, such that long and short
+ * messages balance out. Each cipher is written as soon as its last bit
+ * is done and is identical to the one of a single encryption with the
+ * same salt.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+#include "flatANF.h"
+#include "rng.h"
+#include "encrypt.h"
+#include "cipherFormat.h"
+#include "kryptoSAT.h"
+#include "rangeScheduler.h"
+#include "metrics.h"
+#include "log.h"
+
+
+namespace kryptoSAT{
+
+
+  /// one clear text of encryptBatch()
+  struct batchMessage{
+    string clearFile;
+    /// the cipher is written to outFile.cipher, as by kryptoSAT -t clearFile -o outFile
+    string outFile;
+    bool* text;
+    size_t length;
+    size_t salt;
+    vector<size_t> seeds;
+    /// allocated when the first bit is started, freed when written
+    flatANF* cipher;
+    once_flag allocated;
+    /// bits not done yet
+    atomic<size_t> remaining;
+    atomic<bool> success;
+
+    batchMessage():text(0),length(0),salt(0),cipher(0),remaining(0),success(true){}
+
+    ~batchMessage(){
+      delete[] text;
+      delete[] cipher;
+    }
+  };
+
+
+  /// writes the cipher of message and frees its memory
+  bool finishBatchMessage(batchMessage* message, size_t cipherVars, size_t beta, unsigned int encoderVersion, bool binary){
+    bool re=message->success;
+    if(re){
+      cipherHeader header;
+      header.salt=message->salt;
+      header.textLength=message->length;
+      header.beta=beta;
+      header.encoderVersion=encoderVersion;
+      string file=message->outFile+".cipher";
+      ofstream out(file.c_str(), ios::out | ios::binary);
+      re = out.good() && writeCipher(out, header, message->cipher, cipherVars, binary);
+      out.close();
+      if(re){
+        LOG_DEBUG("Wrote " << (binary ? "binary " : "") << "cipher to " << file);
+      }else{
+        LOG_ERROR("Error saving cipher " << file);
+      }
+    }else{
+      LOG_ERROR("Encryption of " << message->clearFile << " failed!");
+    }
+    delete[] message->cipher;
+    message->cipher=0;
+    delete[] message->text;
+    message->text=0;
+    vector<size_t>().swap(message->seeds);
+    metrics().count("batch.messages",1);
+    return re;
+  }
+
+
+  /// Worker t of encryptBatch(): encrypts the bits handed out by the
+  /// scheduler, bit g is bit g-messageStart[m] of the last message m
+  /// with messageStart[m]<=g.
+  void encryptBatchWorker(unsigned int t, rangeScheduler* scheduler, const rng* prototype, const preparedPublicKey* key, batchMessage* const* messages, const size_t* messageStart, size_t nbrMessages, size_t beta, unsigned int encoderVersion, unsigned int windowThreads, bool binary, atomic<bool>* success){
+    rng* r = spawnEncoderRNG(prototype,encoderVersion);
+    size_t g;
+    while(scheduler->next(t,g)){
+      size_t m = upper_bound(messageStart,messageStart+nbrMessages,g)-messageStart-1;
+      batchMessage* message=messages[m];
+      size_t i=g-messageStart[m];
+      call_once(message->allocated,[message]{message->cipher=new flatANF[message->length];});
+
+      //as encryptBitsWorker() with offset 0
+      r->seed(message->seeds[i],i);
+      if(!encrypt(r, *key, message->text[i], beta, message->cipher[i], encoderVersion, windowThreads)){
+        message->success=false;
+      }
+      if(--message->remaining==0 && !finishBatchMessage(message, key->getNumberOfVars(), beta, encoderVersion, binary)){
+        *success=false;
+      }
+    }
+    delete r;
+  }
+
+
+  /// Encrypts all messages (with their text, length and salt set)
+  /// with encoder version >= 3 and writes their ciphers. The seeds
+  /// and random streams of the bits are those of
+  /// encrypt(prototype,seeds,0,...) for the single message, hence
+  /// the ciphers do not depend on the batch. Returns true iff all
+  /// messages were written.
+  bool encryptBatch(const rng* prototype, const preparedPublicKey& key, vector<batchMessage*>& messages, size_t beta, unsigned int encoderVersion, unsigned int nbrThreads, bool binary){
+    if(nbrThreads<1){
+      nbrThreads=1;
+    }
+    atomic<bool> success(true);
+
+    vector<batchMessage*> scheduled;
+    vector<size_t> messageStart;
+    size_t total=0;
+    for(size_t m=0;m<messages.size();m++){
+      batchMessage* message=messages[m];
+      message->seeds=textSeeds(message->salt, message->text, message->length, encoderVersion);
+      message->remaining=message->length;
+      if(message->length==0){
+        //nothing to schedule, just the header
+        if(!finishBatchMessage(message, key.getNumberOfVars(), beta, encoderVersion, binary)){
+          success=false;
+        }
+        continue;
+      }
+      scheduled.push_back(message);
+      messageStart.push_back(total);
+      total+=message->length;
+    }
+
+    //threads not needed for the bits are used inside the bits
+    unsigned int windowThreads=1;
+    if(nbrThreads>total){
+      if(total>0){
+        windowThreads=nbrThreads/total;
+      }
+      nbrThreads = total>0 ? total : 1;
+    }
+
+    rangeScheduler scheduler(total,nbrThreads);
+    vector<thread> workers;
+    for(unsigned int t=1;t<nbrThreads;t++){
+      workers.push_back(thread(encryptBatchWorker, t, &scheduler, prototype, &key, scheduled.data(), messageStart.data(), scheduled.size(), beta, encoderVersion, windowThreads, binary, &success));
+    }
+    encryptBatchWorker(0, &scheduler, prototype, &key, scheduled.data(), messageStart.data(), scheduled.size(), beta, encoderVersion, windowThreads, binary, &success);
+    for(size_t t=0;t<workers.size();t++){
+      workers[t].join();
+    }
+    metrics().count("batch.steals",scheduler.getSteals());
+    metrics().count("batch.bits",total);
+    return success;
+  }
+
+
+}//end namespace
+
+
+#endif
@@ -48,6 +48,8 @@
 
 #include <list>
 
+#include "log.h"
+
 
 
 enum booleanFctTypes{
@@ -179,7 +181,7 @@ class booleanFct<BFT_INPUT>: public virtual BF{
   /// Caution: non existing variables evaluate to false after writing to CERR
   bool evaluate(const bool *const input) const{
     if(inputVar>=nbrOfVars||inputVar<0){
-      cerr<< "ERR: variable " << inputVar << " does not exist!" <<endl;
+      LOG_ERROR("variable " << inputVar << " does not exist!");
       return false;
     }
     return input[inputVar];
@@ -235,7 +237,7 @@ string booleanFct<BFT_FALSE>::toString() const{
 template<>
 bool booleanFct<BFT_NOT>::evaluate(const bool*const input) const{
   if (size()<1){
-    cerr << "WARN: NOT without argument!"<<endl;
+    LOG_WARN("NOT without argument!");
     return false;
   }
   return ! front()->evaluate(input);
@@ -364,14 +366,14 @@ string booleanFct<BFT_XOR>::toString() const{
 /// In particular, no sorting is performed!
 int compare(const BF* const x,const BF* const y){
   if(x==0){
-    cerr << "ERR: null pointer comparison!"<<endl;
+    LOG_ERROR("null pointer comparison!");
     if(y==0){
       return 0;
     }
     return -42;
   }
   if(y==0){
-    cerr << "ERR: null pointer comparison!"<<endl;
+    LOG_ERROR("null pointer comparison!");
     return 42;
   }
 
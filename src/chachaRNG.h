@@ -0,0 +1,344 @@
+/*****************************************************************************
+ *
+ * @file chachaRNG.h
+ *
+ * @section DESCRIPTION
+ *
+ * Counter based generator on the ChaCha20 block function: the key is
+ * derived from the seed, the block counter runs within a stream and
+ * the stream number takes the place of the nonce. Hence any (seed,
+ * stream) is available in O(1) and the streams are independent.
+ * Keystream is generated eight blocks at a time, with SSE2 or AVX2
+ * (chosen at runtime) where the CPU supports it.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef CHACHARNG_H
+#define CHACHARNG_H
+
+#include <random>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHACHARNG_X86
+#include <immintrin.h>
+#endif
+
+#include "rng.h"
+
+/// number of ChaCha20 blocks generated per refill, one per AVX2 lane
+#define CHACHABLOCKS 8
+
+
+/// ChaCha20 with the original layout: 4 constant words, 8 key words,
+/// a 64 bit block counter (words 12,13) and a 64 bit nonce (words
+/// 14,15), which is the stream number here.
+class chachaRNG : public virtual rng{
+
+ private:
+  random_device rd;
+  unsigned int state[16];
+  /// keystream of CHACHABLOCKS blocks, block b at words [16b,16b+16)
+  unsigned int buffer[16*CHACHABLOCKS];
+  /// next unused word of buffer
+  unsigned int position;
+
+  __extension__ typedef unsigned __int128 uint128;
+
+
+  static inline unsigned int rotate(unsigned int x, int n){
+    return (x << n) | (x >> (32-n));
+  }
+
+  static inline void quarterRound(unsigned int* x, int a, int b, int c, int d){
+    x[a]+=x[b]; x[d]=rotate(x[d]^x[a],16);
+    x[c]+=x[d]; x[b]=rotate(x[b]^x[c],12);
+    x[a]+=x[b]; x[d]=rotate(x[d]^x[a],8);
+    x[c]+=x[d]; x[b]=rotate(x[b]^x[c],7);
+  }
+
+  void setKey(const unsigned int* key, unsigned long long stream){
+    //"expand 32-byte k"
+    state[0]=0x61707865;
+    state[1]=0x3320646e;
+    state[2]=0x79622d32;
+    state[3]=0x6b206574;
+    for(int i=0;i<8;i++){
+      state[4+i]=key[i];
+    }
+    state[12]=0;
+    state[13]=0;
+    state[14]=(unsigned int)stream;
+    state[15]=(unsigned int)(stream>>32);
+    position=16*CHACHABLOCKS;
+  }
+
+  /// advance the 64 bit block counter by CHACHABLOCKS
+  void nextCounter(){
+    unsigned long long c = ((unsigned long long)state[13]<<32 | state[12]) + CHACHABLOCKS;
+    state[12]=(unsigned int)c;
+    state[13]=(unsigned int)(c>>32);
+  }
+
+  /// the blocks counter,...,counter+CHACHABLOCKS-1 of state into out
+  static void blocks(const unsigned int* state, unsigned int* out){
+    for(int b=0;b<CHACHABLOCKS;b++){
+      unsigned int x[16];
+      memcpy(x,state,sizeof(x));
+      unsigned long long c = ((unsigned long long)state[13]<<32 | state[12]) + b;
+      x[12]=(unsigned int)c;
+      x[13]=(unsigned int)(c>>32);
+      unsigned int in12=x[12], in13=x[13];
+      for(int i=0;i<10;i++){
+        quarterRound(x,0,4,8,12);
+        quarterRound(x,1,5,9,13);
+        quarterRound(x,2,6,10,14);
+        quarterRound(x,3,7,11,15);
+        quarterRound(x,0,5,10,15);
+        quarterRound(x,1,6,11,12);
+        quarterRound(x,2,7,8,13);
+        quarterRound(x,3,4,9,14);
+      }
+      for(int i=0;i<16;i++){
+        out[16*b+i] = x[i] + (i==12 ? in12 : i==13 ? in13 : state[i]);
+      }
+    }
+  }
+
+#ifdef CHACHARNG_X86
+
+#define CHACHA_ROTATE_SSE2(x,n) _mm_or_si128(_mm_slli_epi32(x,n),_mm_srli_epi32(x,32-n))
+#define CHACHA_QR_SSE2(a,b,c,d)                                         \
+  a=_mm_add_epi32(a,b); d=CHACHA_ROTATE_SSE2(_mm_xor_si128(d,a),16);   \
+  c=_mm_add_epi32(c,d); b=CHACHA_ROTATE_SSE2(_mm_xor_si128(b,c),12);   \
+  a=_mm_add_epi32(a,b); d=CHACHA_ROTATE_SSE2(_mm_xor_si128(d,a),8);    \
+  c=_mm_add_epi32(c,d); b=CHACHA_ROTATE_SSE2(_mm_xor_si128(b,c),7);
+
+  /// as blocks(), four blocks at a time, lane b of word i is word i of
+  /// block b
+  __attribute__((target("sse2")))
+  static void blocksSSE2(const unsigned int* state, unsigned int* out){
+    for(int g=0;g<CHACHABLOCKS;g+=4){
+      __m128i in[16];
+      for(int i=0;i<16;i++){
+        in[i]=_mm_set1_epi32(state[i]);
+      }
+      unsigned long long c = (unsigned long long)state[13]<<32 | state[12];
+      unsigned int low[4], high[4];
+      for(int b=0;b<4;b++){
+        low[b]=(unsigned int)(c+g+b);
+        high[b]=(unsigned int)((c+g+b)>>32);
+      }
+      in[12]=_mm_loadu_si128((const __m128i*)low);
+      in[13]=_mm_loadu_si128((const __m128i*)high);
+
+      __m128i x[16];
+      for(int i=0;i<16;i++){
+        x[i]=in[i];
+      }
+      for(int i=0;i<10;i++){
+        CHACHA_QR_SSE2(x[0],x[4],x[8],x[12]);
+        CHACHA_QR_SSE2(x[1],x[5],x[9],x[13]);
+        CHACHA_QR_SSE2(x[2],x[6],x[10],x[14]);
+        CHACHA_QR_SSE2(x[3],x[7],x[11],x[15]);
+        CHACHA_QR_SSE2(x[0],x[5],x[10],x[15]);
+        CHACHA_QR_SSE2(x[1],x[6],x[11],x[12]);
+        CHACHA_QR_SSE2(x[2],x[7],x[8],x[13]);
+        CHACHA_QR_SSE2(x[3],x[4],x[9],x[14]);
+      }
+
+      unsigned int lanes[4];
+      for(int i=0;i<16;i++){
+        _mm_storeu_si128((__m128i*)lanes,_mm_add_epi32(x[i],in[i]));
+        for(int b=0;b<4;b++){
+          out[16*(g+b)+i]=lanes[b];
+        }
+      }
+    }
+  }
+
+#define CHACHA_ROTATE_AVX2(x,n) _mm256_or_si256(_mm256_slli_epi32(x,n),_mm256_srli_epi32(x,32-n))
+#define CHACHA_QR_AVX2(a,b,c,d)                                                 \
+  a=_mm256_add_epi32(a,b); d=CHACHA_ROTATE_AVX2(_mm256_xor_si256(d,a),16);     \
+  c=_mm256_add_epi32(c,d); b=CHACHA_ROTATE_AVX2(_mm256_xor_si256(b,c),12);     \
+  a=_mm256_add_epi32(a,b); d=CHACHA_ROTATE_AVX2(_mm256_xor_si256(d,a),8);      \
+  c=_mm256_add_epi32(c,d); b=CHACHA_ROTATE_AVX2(_mm256_xor_si256(b,c),7);
+
+  /// as blocks(), all eight blocks at once
+  __attribute__((target("avx2")))
+  static void blocksAVX2(const unsigned int* state, unsigned int* out){
+    __m256i in[16];
+    for(int i=0;i<16;i++){
+      in[i]=_mm256_set1_epi32(state[i]);
+    }
+    unsigned long long c = (unsigned long long)state[13]<<32 | state[12];
+    unsigned int low[8], high[8];
+    for(int b=0;b<8;b++){
+      low[b]=(unsigned int)(c+b);
+      high[b]=(unsigned int)((c+b)>>32);
+    }
+    in[12]=_mm256_loadu_si256((const __m256i*)low);
+    in[13]=_mm256_loadu_si256((const __m256i*)high);
+
+    __m256i x[16];
+    for(int i=0;i<16;i++){
+      x[i]=in[i];
+    }
+    for(int i=0;i<10;i++){
+      CHACHA_QR_AVX2(x[0],x[4],x[8],x[12]);
+      CHACHA_QR_AVX2(x[1],x[5],x[9],x[13]);
+      CHACHA_QR_AVX2(x[2],x[6],x[10],x[14]);
+      CHACHA_QR_AVX2(x[3],x[7],x[11],x[15]);
+      CHACHA_QR_AVX2(x[0],x[5],x[10],x[15]);
+      CHACHA_QR_AVX2(x[1],x[6],x[11],x[12]);
+      CHACHA_QR_AVX2(x[2],x[7],x[8],x[13]);
+      CHACHA_QR_AVX2(x[3],x[4],x[9],x[14]);
+    }
+
+    unsigned int lanes[8];
+    for(int i=0;i<16;i++){
+      _mm256_storeu_si256((__m256i*)lanes,_mm256_add_epi32(x[i],in[i]));
+      for(int b=0;b<8;b++){
+        out[16*b+i]=lanes[b];
+      }
+    }
+  }
+
+  static bool haveAVX2(){
+    static const bool re=__builtin_cpu_supports("avx2");
+    return re;
+  }
+
+  static bool haveSSE2(){
+    static const bool re=__builtin_cpu_supports("sse2");
+    return re;
+  }
+#endif
+
+  void refill(){
+#ifdef CHACHARNG_X86
+    if(haveAVX2()){
+      blocksAVX2(state,buffer);
+    }else if(haveSSE2()){
+      blocksSSE2(state,buffer);
+    }else{
+      blocks(state,buffer);
+    }
+#else
+    blocks(state,buffer);
+#endif
+    nextCounter();
+    position=0;
+  }
+
+  unsigned int next32(){
+    if(position==16*CHACHABLOCKS){
+      refill();
+    }
+    return buffer[position++];
+  }
+
+
+ public:
+
+  chachaRNG(){
+    unsigned int key[8]={0,0,0,0,0,0,0,0};
+    setKey(key,0);
+  }
+
+  ~chachaRNG(){}
+
+  size_t getGoodSeed(){
+    return rd();
+  }
+
+  void randomise(size_t entropy){
+    unsigned int key[8];
+    for(int i=0;i<8;i++){
+      key[i]=rd();
+    }
+    unsigned long long e=entropy;
+    key[0]^=(unsigned int)e;
+    key[1]^=(unsigned int)(e>>32);
+    setKey(key,0);
+  }
+
+  void seed(size_t seed){
+    this->seed(seed,0);
+  }
+
+  /// The key is the seed padded with zeros, the nonce the stream number.
+  void seed(size_t seed, size_t stream){
+    unsigned long long s=seed;
+    unsigned int key[8]={(unsigned int)s,(unsigned int)(s>>32),0,0,0,0,0,0};
+    setKey(key,stream);
+  }
+
+  rng* spawn() const{
+    return new chachaRNG();
+  }
+
+  bool randomBool(){
+    return next32() & 1;
+  }
+
+  /// Lemire's multiply and reject method
+  size_t randomInt(size_t max){
+    unsigned long long bound=max;
+    uint128 x = (uint128)randomBits() * bound;
+    unsigned long long low = (unsigned long long)x;
+    if(low < bound){
+      unsigned long long threshold = -bound % bound;
+      while(low < threshold){
+        x = (uint128)randomBits() * bound;
+        low = (unsigned long long)x;
+      }
+    }
+    return (size_t)(x >> 64);
+  }
+
+  unsigned long long randomBits(){
+    unsigned long long re=next32();
+    return re | (unsigned long long)next32() << 32;
+  }
+
+};
+
+#endif
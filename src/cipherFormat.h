@@ -0,0 +1,353 @@
+/*****************************************************************************
+ *
+ * @file cipherFormat.h
+ *
+ * @section DESCRIPTION
+ *
+ * Reading and writing ciphers in the text and the binary format, from
+ * memory buffers and to streams. Shared by the command line tool and
+ * the library.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef CIPHERFORMAT_H
+#define CIPHERFORMAT_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <iomanip>
+
+#include "functionParser.h"
+#include "flatANF.h"
+#include "mappedFile.h"
+#include "encrypt.h"
+#include "log.h"
+
+
+/// Binary cipher files start with this magic, followed by the version
+/// of the binary format. Text ciphers start with a comment or 's'.
+#define BINARYCIPHERMAGIC "KRYPTOSAT-CIPHER"
+#define BINARYCIPHERFORMAT 1
+
+/// Text length field width in headers written with a lengthPos, where
+/// the length is only known at the end
+#define PATCHABLELENGTHDIGITS 20
+#define PATCHABLELENGTHBYTES 10
+
+
+namespace kryptoSAT{
+
+
+  /// the parameters in front of the encrypted bits
+  struct cipherHeader{
+    size_t salt;
+    /// number of encrypted bits
+    size_t textLength;
+    size_t beta;
+    unsigned int encoderVersion;
+
+    cipherHeader():salt(0),textLength(0),beta(3),encoderVersion(LEGACYENCODERVERSION){}
+  };
+
+
+  /// parses the line [line,end) 's salt textLength beta [encoderVersion]'
+  bool readCipherHeader(cipherHeader& header, const char* line, const char* end){
+    bool found = dimacsScanner::nextTokenIs(line,end,"s")
+      && dimacsScanner::readSize(line,end,header.salt)
+      && dimacsScanner::readSize(line,end,header.textLength)
+      && dimacsScanner::readSize(line,end,header.beta);
+    //ciphers written before the version was recorded
+    header.encoderVersion = LEGACYENCODERVERSION;
+    size_t version;
+    if(found && dimacsScanner::readSize(line,end,version)){
+      header.encoderVersion = version;
+    }
+    return found;
+  }
+
+  /// true iff [begin,end) starts with the binary cipher magic
+  bool isBinaryCipher(const char* begin, const char* end){
+    size_t length=strlen(BINARYCIPHERMAGIC);
+    return (size_t)(end-begin)>=length && memcmp(begin,BINARYCIPHERMAGIC,length)==0;
+  }
+
+  /// parses the header of a binary cipher and advances p behind it
+  bool readBinaryCipherHeader(cipherHeader& header, const char*& p, const char* end){
+    p+=strlen(BINARYCIPHERMAGIC);
+    unsigned long long format, salt, length, beta, version;
+    if(!functionParser::readVarint(p,end,format) || format!=BINARYCIPHERFORMAT){
+      LOG_ERROR("Unknown binary cipher format.");
+      return false;
+    }
+    if(!functionParser::readVarint(p,end,salt) || !functionParser::readVarint(p,end,length)
+       || !functionParser::readVarint(p,end,beta) || !functionParser::readVarint(p,end,version)){
+      LOG_ERROR("File format error.");
+      return false;
+    }
+    header.salt=salt;
+    header.textLength=length;
+    header.beta=beta;
+    header.encoderVersion=version;
+    return true;
+  }
+
+
+  /// Reads the ANF of the encrypted bit i<textLength into bit. All
+  /// bits have to refer to the same number of variables, bit 0 sets
+  /// cipherVars.
+  bool readCipherBit(dimacsScanner& in, size_t textLength, size_t i, flatANF& bit, size_t& cipherVars){
+    if(i>=textLength){
+      LOG_ERROR("More encrypted bits than the text length " << textLength);
+      return false;
+    }
+    size_t vars;
+    if(!functionParser::readANF(in,bit,vars)){
+      LOG_ERROR("Error reading cipher.");
+      return false;
+    }
+    if(i==0){
+      cipherVars=vars;
+    }else if(vars!=cipherVars){
+      LOG_ERROR("Encrypted bits refer to different numbers of variables.");
+      return false;
+    }
+    return true;
+  }
+
+  /// True iff textLength bits may follow in [p,end): the stored
+  /// length is not trusted, but every bit takes at least one byte.
+  bool checkTextLength(const cipherHeader& header, const char* p, const char* end){
+    if(header.textLength > (size_t)(end-p)){
+      LOG_ERROR("Text length " << header.textLength << " exceeds the " << (end-p) << " bytes of encrypted bits.");
+      return false;
+    }
+    return true;
+  }
+
+  /// replaces cipher by a new array holding bits
+  void storeCipher(vector<flatANF>& bits, flatANF*& cipher){
+    delete[] cipher;
+    cipher = new flatANF[bits.size()];
+    for(size_t i=0;i<bits.size();i++){
+      cipher[i]=std::move(bits[i]);
+    }
+    vector<flatANF>().swap(bits);
+  }
+
+  /// reads the encrypted bits of a binary cipher from [p,end) into bits
+  bool readBinaryCipherBits(const char* p, const char* end, const cipherHeader& header, vector<flatANF>& bits, size_t& cipherVars){
+    while(bits.size()<header.textLength){
+      size_t vars;
+      bits.push_back(flatANF());
+      if(!functionParser::readBinaryANF(p,end,bits.back(),vars)){
+        LOG_ERROR("Error reading cipher.");
+        return false;
+      }
+      if(bits.size()==1){
+        cipherVars=vars;
+      }else if(vars!=cipherVars){
+        LOG_ERROR("Encrypted bits refer to different numbers of variables.");
+        return false;
+      }
+    }
+    if(p!=end){
+      LOG_ERROR("More encrypted bits than the text length " << header.textLength);
+      return false;
+    }
+    return true;
+  }
+
+  /// reads the binary cipher [begin,end), cf. readCipher()
+  bool readBinaryCipher(const char* begin, const char* end, cipherHeader& header, flatANF*& cipher, size_t& cipherVars){
+    const char* p=begin;
+    if(!readBinaryCipherHeader(header,p,end)){
+      return false;
+    }
+    LOG_INFO("Reading binary cipher of length " << header.textLength << " salt = " << header.salt << " encoder version = " << header.encoderVersion);
+
+    vector<flatANF> bits;
+    bool re = checkTextLength(header,p,end) && readBinaryCipherBits(p,end,header,bits,cipherVars);
+    storeCipher(bits,cipher);
+    return re;
+  }
+
+  /// reads the encrypted bits of a text cipher from in into bits
+  bool readCipherBits(dimacsScanner& in, const cipherHeader& header, vector<flatANF>& bits, size_t& cipherVars){
+    const char *line, *lineEnd;
+    while(in.peekLine(line,lineEnd)){
+      bits.push_back(flatANF());
+      if(!readCipherBit(in,header.textLength,bits.size()-1,bits.back(),cipherVars)){
+        return false;
+      }
+    }
+    if(bits.size() != header.textLength){
+      LOG_ERROR("Read " << bits.size() << " encrypted bits, although text length should be " << header.textLength);
+      return false;
+    }
+    return true;
+  }
+
+  /// Reads the cipher [begin,end) in the text or the binary format
+  /// (detected by its magic). The bits are stored in a new array
+  /// cipher (any old one is deleted), also on errors. The array only
+  /// grows with the bits actually read, whatever the header claims.
+  bool readCipher(const char* begin, const char* end, cipherHeader& header, flatANF*& cipher, size_t& cipherVars){
+    if(isBinaryCipher(begin,end)){
+      return readBinaryCipher(begin,end,header,cipher,cipherVars);
+    }
+
+    dimacsScanner in(begin,end);
+    const char *line, *lineEnd;
+    header.salt=0;
+    bool found=false;
+    while(!found && in.nextLine(line,lineEnd)){
+      if(*line=='s'){
+        found = readCipherHeader(header,line,lineEnd);
+      }
+    }
+
+    if(!found){
+      LOG_ERROR("File format error.");
+      return false;
+    }
+    LOG_INFO("Reading cipher of length " << header.textLength << " salt = " << header.salt << " encoder version = " << header.encoderVersion);
+
+    //anything in front of the first ANF is ignored
+    while(in.peekLine(line,lineEnd) && *line!='p'){
+      in.nextLine(line,lineEnd);
+    }
+    if(!in.peekLine(line,lineEnd)){
+      LOG_ERROR("Error reading cipher.");
+      return false;
+    }
+
+    vector<flatANF> bits;
+    bool re = checkTextLength(header,line,end) && readCipherBits(in,header,bits,cipherVars);
+    storeCipher(bits,cipher);
+    return re;
+  }
+
+
+
+  /// Writes the cipher header in the text or the binary format.
+  /// Binary cipher file: BINARYCIPHERMAGIC, then varints of the format
+  /// version, salt, text length, beta and encoder version, followed by
+  /// the encrypted bits as written by writeBinaryANF().
+  /// If lengthPos!=0 the text length is written with a fixed width and
+  /// its position is stored in *lengthPos for patchCipherLength().
+  bool writeCipherHeader(ostream& out, const cipherHeader& header, bool binary, streampos* lengthPos=0){
+    if(binary){
+      string buffer(BINARYCIPHERMAGIC);
+      functionParser::writeVarint(buffer,BINARYCIPHERFORMAT);
+      functionParser::writeVarint(buffer,header.salt);
+      if(lengthPos!=0){
+        *lengthPos = out.tellp() + (streamoff)buffer.size();
+        functionParser::writePaddedVarint(buffer,header.textLength,PATCHABLELENGTHBYTES);
+      }else{
+        functionParser::writeVarint(buffer,header.textLength);
+      }
+      functionParser::writeVarint(buffer,header.beta);
+      functionParser::writeVarint(buffer,header.encoderVersion);
+      out.write(buffer.data(),buffer.size());
+      return out.good();
+    }
+
+    out << "c Cipher"<<endl;
+    out << "c Format of the next line: 's salt textLength beta encoderVersion'"<<endl;
+    out << "s "<<header.salt<< " ";
+    if(lengthPos!=0){
+      *lengthPos = out.tellp();
+      out << setw(PATCHABLELENGTHDIGITS) << setfill('0') << header.textLength << setfill(' ');
+    }else{
+      out << header.textLength;
+    }
+    out << " " << header.beta << " " << header.encoderVersion << endl << "c" <<endl;
+    return out.good();
+  }
+
+  /// overwrites the text length written by writeCipherHeader(out,header,binary,&lengthPos)
+  bool patchCipherLength(ostream& out, size_t textLength, bool binary, streampos lengthPos){
+    streampos end=out.tellp();
+    out.seekp(lengthPos);
+    if(binary){
+      string buffer;
+      functionParser::writePaddedVarint(buffer,textLength,PATCHABLELENGTHBYTES);
+      out.write(buffer.data(),buffer.size());
+    }else{
+      out << setw(PATCHABLELENGTHDIGITS) << setfill('0') << textLength << setfill(' ');
+    }
+    out.seekp(end);
+    return out.good();
+  }
+
+  /// writes one encrypted bit in the text or the binary format
+  bool writeCipherBit(ostream& out, const flatANF& bit, size_t cipherVars, bool binary){
+    if(binary){
+      string buffer;
+      if(!functionParser::writeBinaryANF(buffer, bit, cipherVars)){
+        return false;
+      }
+      out.write(buffer.data(),buffer.size());
+      return out.good();
+    }
+    out << "c ----------------------------------------"<<endl;
+    out << "c --------------next bit------------------"<<endl;
+    out << "c ----------------------------------------"<<endl;
+    return functionParser::writeANF(out, bit, cipherVars);
+  }
+
+  /// writes the header and the header.textLength bits of cipher
+  bool writeCipher(ostream& out, const cipherHeader& header, const flatANF* cipher, size_t cipherVars, bool binary){
+    bool re=writeCipherHeader(out,header,binary);
+    for(size_t i=0;i<header.textLength;i++){
+      re= re && writeCipherBit(out, cipher[i], cipherVars, binary);
+    }
+    return re;
+  }
+
+
+}//end namespace
+
+
+#endif
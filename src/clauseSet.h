@@ -0,0 +1,139 @@
+/*****************************************************************************
+ *
+ * @file clauseSet.h
+ *
+ * @section DESCRIPTION
+ *
+ * Hash set over the clauses of a growing flatCNF, used to reject
+ * duplicate clauses during key generation in expected constant time.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+#ifndef CLAUSESET_H
+#define CLAUSESET_H
+
+#include <vector>
+
+#include "flatCNF.h"
+
+
+
+/// Open addressing (linear probing) hash set of clause indices of a
+/// flatCNF. Two clauses are equal iff they consist of the same
+/// literals in the same order, cf. flatCNF::equalClauses(). The
+/// clauses themselves stay in the CNF, the set only stores indices.
+class clauseSet{
+
+ protected:
+  const flatCNF* cnf;
+  /// clause index+1, 0 marks an empty slot
+  vector<size_t> table;
+  size_t count;
+
+  /// slot of the clause [begin,end) or of the empty slot it would go to
+  size_t find(const int* begin, const int* end) const{
+    size_t mask=table.size()-1;
+    size_t size=end-begin;
+    for(size_t s=hash(begin,end)&mask;;s=(s+1)&mask){
+      if(table[s]==0){
+        return s;
+      }
+      size_t i=table[s]-1;
+      if(cnf->clauseSize(i)==size && equal(begin,end,cnf->clauseBegin(i))){
+        return s;
+      }
+    }
+  }
+
+  void rehash(size_t capacity){
+    vector<size_t> old(capacity,0);
+    old.swap(table);
+    for(size_t s=0;s<old.size();s++){
+      if(old[s]!=0){
+        size_t i=old[s]-1;
+        table[find(cnf->clauseBegin(i),cnf->clauseEnd(i))]=old[s];
+      }
+    }
+  }
+
+ public:
+
+  static size_t hash(const int* begin, const int* end){
+    unsigned long long h=14695981039346656037ULL;
+    for(;begin!=end;begin++){
+      h = (h ^ (unsigned int)*begin) * 1099511628211ULL;
+    }
+    return h ^ (h>>32);
+  }
+
+  /// empty set for clauses of cnf, sized for expected clauses
+  clauseSet(const flatCNF* _cnf, size_t expected):cnf(_cnf),table(16,0),count(0){
+    size_t capacity=16;
+    while(capacity<2*expected){
+      capacity*=2;
+    }
+    table.assign(capacity,0);
+  }
+
+  size_t size() const{return count;}
+
+  /// true iff a clause equal to [begin,end) is in the set
+  bool contains(const int* begin, const int* end) const{
+    return table[find(begin,end)]!=0;
+  }
+
+  /// adds the clause i of the cnf, unless an equal one is in the set
+  /// already. Returns true iff it was added.
+  bool insert(size_t i){
+    size_t s=find(cnf->clauseBegin(i),cnf->clauseEnd(i));
+    if(table[s]!=0){
+      return false;
+    }
+    table[s]=i+1;
+    count++;
+    if(2*count>table.size()){
+      rehash(2*table.size());
+    }
+    return true;
+  }
+
+};
+
+
+#endif
@@ -0,0 +1,263 @@
+/*****************************************************************************
+ *
+ * @file daemonProtocol.h
+ *
+ * @section DESCRIPTION
+ *
+ * Wire protocol between kryptoSATd and its clients over a Unix domain
+ * socket, and the framing helpers both sides use.
+ *
+ * Every message is a frame: a 32 bit little endian length followed by
+ * that many bytes. A request frame holds the request id (u32), the
+ * operation (u8), the length of the key name (u16), the key name and
+ * the body of the operation. A response frame holds the id of its
+ * request (u32), a libkryptosat::status (u8) and the body, an error
+ * message if the status is not STATUS_OK. Responses may come in any
+ * order, the id tells which request they answer.
+ *
+ * Bodies: ENCRYPT sends salt (u64), whether the salt is given (u8, 0
+ * for a random one), beta (u32), encoder version (u32, 0 for the
+ * current one), cipher format (u8) and the clear text with one byte
+ * per bit, the answer is the cipher. DECRYPT sends a cipher
+ * in either format and gets one byte per bit. VERIFY sends a cipher
+ * and gets one byte, 1 iff re-encrypting its decryption gives the same
+ * cipher. STATS needs no key and returns the latency statistics of the
+ * daemon as JSON.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef DAEMONPROTOCOL_H
+#define DAEMONPROTOCOL_H
+
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/// default socket path of kryptoSATd
+#define DAEMONSOCKET "/tmp/kryptoSATd.socket"
+
+/// larger frames are rejected, the connection is closed
+#define DAEMONMAXFRAME (1u<<30)
+/// readFrame() grows the payload by at most this many bytes per read
+#define DAEMONREADCHUNK (1u<<16)
+/// bytes of a response frame in front of the body
+#define DAEMONRESPONSEHEADER 5
+
+#define DAEMONOP_ENCRYPT 1
+#define DAEMONOP_DECRYPT 2
+#define DAEMONOP_VERIFY 3
+#define DAEMONOP_STATS 4
+
+
+namespace daemonProtocol{
+
+
+  void putU8(string& out, unsigned int x){
+    out.push_back((char)(x&0xff));
+  }
+
+  void putU16(string& out, unsigned int x){
+    putU8(out,x);
+    putU8(out,x>>8);
+  }
+
+  void putU32(string& out, unsigned long x){
+    putU16(out,x&0xffff);
+    putU16(out,(x>>16)&0xffff);
+  }
+
+  void putU64(string& out, unsigned long long x){
+    putU32(out,x&0xffffffffULL);
+    putU32(out,(x>>32)&0xffffffffULL);
+  }
+
+
+  /// Sequential reader of the fields of a frame [p,end). Reading
+  /// behind the end fails and leaves the value unchanged.
+  class fieldReader{
+
+  protected:
+    const char* p;
+    const char* end;
+
+  public:
+
+    fieldReader(const char* begin, const char* _end):p(begin),end(_end){}
+
+    const char* position() const{return p;}
+    size_t remaining() const{return end-p;}
+
+    bool getUnsigned(unsigned long long& x, unsigned int bytes){
+      if(remaining()<bytes){
+        return false;
+      }
+      x=0;
+      for(unsigned int b=0;b<bytes;b++){
+        x |= (unsigned long long)(unsigned char)p[b] << (8*b);
+      }
+      p+=bytes;
+      return true;
+    }
+
+    bool getString(string& s, size_t length){
+      if(remaining()<length){
+        return false;
+      }
+      s.assign(p,length);
+      p+=length;
+      return true;
+    }
+
+  };
+
+
+  /// the header of a request frame, cf. the file description
+  string requestHeader(unsigned long id, unsigned int op, const string& key){
+    string re;
+    putU32(re,id);
+    putU8(re,op);
+    putU16(re,key.size());
+    re+=key;
+    return re;
+  }
+
+  /// the header of a response frame
+  string responseHeader(unsigned long id, unsigned int status){
+    string re;
+    putU32(re,id);
+    putU8(re,status);
+    return re;
+  }
+
+
+  /// writes all of [data,data+length) to fd
+  bool writeAll(int fd, const char* data, size_t length){
+    while(length>0){
+      ssize_t w = send(fd,data,length,MSG_NOSIGNAL);
+      if(w<0 && errno==EINTR){
+        continue;
+      }
+      if(w<=0){
+        return false;
+      }
+      data+=w;
+      length-=w;
+    }
+    return true;
+  }
+
+  /// reads exactly length bytes, false on errors or end of file
+  bool readAll(int fd, char* data, size_t length){
+    while(length>0){
+      ssize_t r = read(fd,data,length);
+      if(r<0 && errno==EINTR){
+        continue;
+      }
+      if(r<=0){
+        return false;
+      }
+      data+=r;
+      length-=r;
+    }
+    return true;
+  }
+
+  /// sends the frame of the payload header+body, false on errors and
+  /// for payloads above DAEMONMAXFRAME, which readFrame() would refuse
+  bool writeFrame(int fd, const string& header, const char* body, size_t bodyLength){
+    if(bodyLength > DAEMONMAXFRAME-header.size()){
+      return false;
+    }
+    string prefix;
+    putU32(prefix,header.size()+bodyLength);
+    prefix+=header;
+    return writeAll(fd,prefix.data(),prefix.size()) && writeAll(fd,body,bodyLength);
+  }
+
+  /// Reads the next frame into payload. False at the end of the
+  /// connection, on errors and for frames above DAEMONMAXFRAME.
+  /// The payload grows with the received bytes, so a length prefix
+  /// alone does not allocate the whole frame.
+  bool readFrame(int fd, string& payload){
+    char prefix[4];
+    if(!readAll(fd,prefix,4)){
+      return false;
+    }
+    unsigned long long length;
+    fieldReader(prefix,prefix+4).getUnsigned(length,4);
+    if(length>DAEMONMAXFRAME){
+      return false;
+    }
+    payload.clear();
+    while(payload.size()<length){
+      size_t done=payload.size();
+      size_t chunk=min<size_t>(length-done,DAEMONREADCHUNK);
+      payload.resize(done+chunk);
+      if(!readAll(fd,&payload[done],chunk)){
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  /// fills the address of the socket file path, false if it is too long
+  bool socketAddress(const string& path, sockaddr_un& address){
+    memset(&address,0,sizeof(address));
+    address.sun_family=AF_UNIX;
+    if(path.size()>=sizeof(address.sun_path)){
+      return false;
+    }
+    memcpy(address.sun_path,path.c_str(),path.size()+1);
+    return true;
+  }
+
+
+}//end namespace
+
+
+#endif
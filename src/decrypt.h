@@ -0,0 +1,249 @@
+/*****************************************************************************
+ *
+ * @file decrypt.h
+ *
+ * @section DESCRIPTION
+ *
+ * Decryption engine: evaluates ciphers in ANF on a private key packed
+ * into machine words. The variables of all summands are looked up in
+ * bulk (with AVX2 gathers where the CPU supports it, chosen at
+ * runtime) and each summand is then checked with word operations.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+#ifndef DECRYPT_H
+#define DECRYPT_H
+
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KRYPTOSAT_X86
+#include <immintrin.h>
+#endif
+
+#include "flatANF.h"
+
+namespace kryptoSAT{
+
+
+  /// Private key packed into 32 bit words, variable v is the bit
+  /// (v-1)%32 of the word (v-1)/32. The words are padded, such that
+  /// bulk reads of any valid variable stay inside the buffer.
+  class packedKey{
+
+  protected:
+    size_t nbrOfVars;
+    vector<unsigned int> words;
+
+  public:
+
+    packedKey(const bool* key, const size_t& length):nbrOfVars(length),words(length/32+8,0){
+      for(size_t i=0;i<length;i++){
+        if(key[i]){
+          words[i/32] |= 1u << (i%32);
+        }
+      }
+    }
+
+    size_t getNumberOfVars() const{return nbrOfVars;}
+
+    const unsigned int* data() const{return words.data();}
+
+    /// value of variable v>=1
+    bool get(unsigned int v) const{
+      return (words[(v-1)/32] >> ((v-1)%32)) & 1;
+    }
+
+  };
+
+
+
+  /// truth[e/64] bit e%64 = key value of the e-th variable entry in [begin,end), scalar version
+  void lookupVariables(const packedKey& key, const unsigned int* begin, const unsigned int* end, unsigned long long* truth){
+    size_t nbr=end-begin;
+    for(size_t w=0;w*64<nbr;w++){
+      unsigned long long t=0;
+      size_t to = nbr-w*64 < 64 ? nbr-w*64 : 64;
+      for(size_t b=0;b<to;b++){
+        t |= (unsigned long long)key.get(begin[w*64+b]) << b;
+      }
+      truth[w]=t;
+    }
+  }
+
+#ifdef KRYPTOSAT_X86
+  /// as lookupVariables, eight entries at a time via AVX2 gathers
+  __attribute__((target("avx2")))
+  void lookupVariablesAVX2(const packedKey& key, const unsigned int* begin, const unsigned int* end, unsigned long long* truth){
+    size_t nbr=end-begin;
+    const int* words=(const int*)key.data();
+    const __m256i one=_mm256_set1_epi32(1);
+    const __m256i low=_mm256_set1_epi32(31);
+    size_t w=0;
+    for(;(w+1)*64<=nbr;w++){
+      unsigned long long t=0;
+      for(size_t b=0;b<64;b+=8){
+        __m256i v=_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(begin+w*64+b)),one);
+        __m256i word=_mm256_i32gather_epi32(words,_mm256_srli_epi32(v,5),4);
+        __m256i bit=_mm256_srlv_epi32(word,_mm256_and_si256(v,low));
+        //move the bit into the sign position for movemask
+        unsigned int mask=_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_slli_epi32(bit,31)));
+        t |= (unsigned long long)mask << b;
+      }
+      truth[w]=t;
+    }
+    lookupVariables(key,begin+w*64,end,truth+w);
+  }
+
+  bool haveAVX2(){
+    static const bool re=__builtin_cpu_supports("avx2");
+    return re;
+  }
+#endif
+
+
+  /// true iff the bits [from,to) of truth are all set
+  inline bool allSet(const unsigned long long* truth, size_t from, size_t to){
+    while(from<to){
+      size_t off=from%64;
+      size_t len = to-from < 64-off ? to-from : 64-off;
+      unsigned long long mask = (len==64) ? ~0ULL : ((1ULL<<len)-1) << off;
+      if((truth[from/64] & mask) != mask){
+        return false;
+      }
+      from+=len;
+    }
+    return true;
+  }
+
+
+  /// Evaluates the ANF f on the key, i.e. decrypts one bit. All
+  /// variables of f have to be in [1,key.getNumberOfVars()].
+  /// The summands are processed in chunks, so the extra memory is bounded.
+  bool evaluate(const packedKey& key, const flatANF& f){
+    const size_t chunk=1<<16;
+    vector<unsigned long long> truth(chunk/64+2);
+    bool re=false;
+
+    size_t i=0;
+    while(i<f.size()){
+      //monomials [i,j) with their entries starting at base
+      const unsigned int* base=f.monomialBegin(i);
+      size_t j=i;
+      while(j<f.size() && (size_t)(f.monomialEnd(j)-base)<=chunk){
+        j++;
+      }
+      if(j==i){
+        //single huge monomial
+        truth.resize(f.monomialSize(i)/64+2);
+        j=i+1;
+      }
+      const unsigned int* end=f.monomialEnd(j-1);
+
+#ifdef KRYPTOSAT_X86
+      if(haveAVX2()){
+        lookupVariablesAVX2(key,base,end,truth.data());
+      }else{
+        lookupVariables(key,base,end,truth.data());
+      }
+#else
+      lookupVariables(key,base,end,truth.data());
+#endif
+
+      for(;i<j;i++){
+        re ^= allSet(truth.data(),f.monomialBegin(i)-base,f.monomialEnd(i)-base);
+      }
+    }
+
+    return re;
+  }
+
+
+
+  /// Evaluates an ANF summand by summand as it is read, without ever
+  /// holding more than a bounded buffer of it. Summands are collected
+  /// up to a fixed number of variable entries and then evaluated in one
+  /// go by evaluate(), hence memory does not depend on the ANF size.
+  class streamEvaluator{
+
+  protected:
+    const packedKey& key;
+    flatANF buffer;
+    bool value;
+
+    static const size_t bufferEntries=1<<16;
+
+    void flush(){
+      value ^= evaluate(key,buffer);
+      buffer.clear();
+    }
+
+  public:
+
+    streamEvaluator(const packedKey& _key):key(_key),value(false){
+      buffer.reserve(bufferEntries/4,bufferEntries);
+    }
+
+    /// start a new ANF
+    void reset(){
+      buffer.clear();
+      value=false;
+    }
+
+    /// add the summand [begin,end), all variables in [1,key.getNumberOfVars()]
+    void addMonomial(const unsigned int* begin, const unsigned int* end){
+      if(buffer.getNumberOfEntries()+(end-begin) > bufferEntries && buffer.size()>0){
+        flush();
+      }
+      buffer.addMonomial(begin,end);
+    }
+
+    /// value of the summands added since the last reset()
+    bool result(){
+      flush();
+      return value;
+    }
+
+  };
+
+
+}//end namespace
+
+
+#endif
@@ -47,92 +47,77 @@
 #ifndef ENCODE_H
 #define ENCODE_H
 
-#define ENCODERVERSION 2
+/// Encoder versions, the one used is recorded in the cipher header:
+/// 2: one random stream for the whole text, seeded with the salt XOR
+///    the first 64 bits of the text.
+/// 3: independent random stream per bit, stream i of the seed
+///    salt XOR hashText(text) encrypts bit i.
+/// 4: as 3, but the windows are encrypted in blocks of
+///    WINDOWBLOCKSIZE, block b with the sub-stream b of a seed drawn
+///    from the stream of the bit (after the permutation).
+/// 5: streaming only: as 4, but bit i uses the stream i of a secret
+///    drawn at random for the message (streamSecret()), so a bit can
+///    be encrypted before the rest of the text is known. The
+///    generators are chachaRNG. The secret is not stored, the salt in
+///    the header is unused, hence such a cipher can not be verified by
+///    encrypting again (nor can guesses of the text).
+/// 6: as 4 (5 is a side branch for streaming), but the permutation
+///    of the clauses is drawn by a Fisher-Yates shuffle, i.e. with
+///    m-1 random numbers instead of O(m^2). As in 3 and 4, bit i uses
+///    the stream i of the salt XOR hashText() of the whole text.
+/// 7: as 6 (same seeds and permutation), but the random functions
+///    are drawn as bitmasks over the subsets of their variables, 64
+///    subsets per random number.
+/// 8: as 7 (same seeds), but all generators are put behind a
+///    pooledRNG, i.e. booleans come from a 64 bit pool and bounded
+///    integers from Lemire's method.
+/// 9: as 8, but the generators are chachaRNG, whatever the kind of
+///    the given one.
+#define ENCODERVERSION 9
+#define STREAMINGENCODERVERSION 5
+#define LEGACYENCODERVERSION 2
+#define WINDOWBLOCKSIZE 64
+/// bound on the variables of a random function of a window, these
+/// have up to 2^MAXRANDOMFUNCTIONVARS summands (cf. validBeta())
+#define MAXRANDOMFUNCTIONVARS 12
 #include <ctime>
 #include <limits>
 #include <cstddef>
 #include <assert.h>
+#include <thread>
+#include <atomic>
 
 #include "functionParser.h"
 #include "booleanFct.h"
+#include "flatCNF.h"
+#include "flatANF.h"
+#include "anfAccumulator.h"
 #include "rng.h"
+#include "chachaRNG.h"
+#include "metrics.h"
+#include "log.h"
 
 namespace kryptoSAT{
 
 
-  //format for ANF: list<list<unsigned int>>
-  //unsigned int = variable number>0
-  //0=const 1
+  //format for ANF: flatANF
+  //variable numbers >0, the empty monomial is the constant 1
 
   //forwards
-  list<list<unsigned int>>& addToANF(list<list<unsigned int>>& g,const list<list<unsigned int>>& gp);
-  list<list<unsigned int>>& multiplyToANF(list<list<unsigned int>>& g,const list<list<unsigned int>>& gp, bool sortResult=true);
+  flatANF& addToANF(flatANF& g,const flatANF& gp);
+  flatANF& multiplyToANF(flatANF& g,const flatANF& gp, bool sortResult=true);
+  flatANF& multiplyToANF(flatANF& g,const flatANF& gp, size_t from, size_t to, bool sortResult=true);
 
 
 
 
   //to string
-  template<class T>
-    std::ostream& operator<<(ostream& os, const  list<T>& obj){
-    os << "(";
-    for(typename list<T>::const_iterator i=obj.begin(); i != obj.end();i++){
-      os << *i;
-      if(next(i)!=obj.end()){
-        os <<", ";
-      }
-    }
-    os << ")";
-
+  std::ostream& operator<<(ostream& os, const flatANF& obj){
+    os << obj.toString();
     return os;
   }
 
 
-  int compare(const list<unsigned int>& x,const list<unsigned int>& y){
-    //    cout << "comparing " << x << " with " << y << endl;
-    /*    if(x.size()<y.size())
-          return -1;
-          if(y.size()<x.size())
-          return 1;
-    */
-    list<unsigned int>::const_iterator i=x.begin();
-    list<unsigned int>::const_iterator j=y.begin();
-    while(true){
-      if(i==x.end()){
-        if(j==y.end()){
-          return 0;
-        }
-        return -1;
-      }
-      if(j==y.end())
-        return 1;
-      if (*i<*j)
-        return -1;
-      if (*i>*j)
-        return 1;
-      j++;
-      i++;
-    }
-  }
-
-  /// comparison operators
-  inline bool operator< (const list<unsigned int>& x,const list<unsigned int>& y){
-    return compare(x,y)<0;
-  }
-
-  bool cmp (const list<unsigned int>& x,const list<unsigned int>& y){//explicitly needed in sort...?
-    return x<y;
-  }
-
-  inline bool operator==(const list<unsigned int>& x,const list<unsigned int>& y){
-    return compare(x,y)==0;
-  }
-
-  inline bool operator!=(const list<unsigned int>& lhs, const list<unsigned int>& rhs){return !(lhs == rhs);}
-  inline bool operator> (const list<unsigned int>& lhs, const list<unsigned int>& rhs){return rhs < lhs;}
-  inline bool operator<=(const list<unsigned int>& lhs, const list<unsigned int>& rhs){return !(lhs > rhs);}
-  inline bool operator>=(const list<unsigned int>& lhs, const list<unsigned int>& rhs){return !(lhs < rhs);}
-
-
 
 
   //////////////////////////////////////////////////////////////////////////
@@ -141,7 +126,13 @@ namespace kryptoSAT{
   /// takes two function in ANF and replaces the first one by a newly
   /// generated function given by the product (AND) of the two
   /// if !sortResult, the result needs to be run through sortANF(*,subsort=false) some time later to bring it into ANF
-  list<list<unsigned int>>& multiplyToANF(list<list<unsigned int>>& g,const list<list<unsigned int>>& gp, bool sortResult){
+  flatANF& multiplyToANF(flatANF& g,const flatANF& gp, bool sortResult){
+    return multiplyToANF(g,gp,0,gp.size(),sortResult);
+  }
+
+  /// as multiplyToANF(g,gp,sortResult), where the second factor is the
+  /// sum of the monomials [from,to) of gp only
+  flatANF& multiplyToANF(flatANF& g,const flatANF& gp, size_t from, size_t to, bool sortResult){
 
     //    cout << "----Multiplying " << g << " with " << gp << "----"<<endl;
 
@@ -151,7 +142,7 @@ namespace kryptoSAT{
       return g;
     }
 
-    if (gp.size()==0){
+    if (from==to){
       g.clear();
       //      cout << "=0, nothing to do.\n----Multiplication done----"<<endl;
       return g;
@@ -159,13 +150,16 @@ namespace kryptoSAT{
 
 
     //multiplication by 1
-    if(gp.size()==1 && gp.front().front()==0){
+    if(to-from==1 && gp.monomialSize(from)==0){
       //      cout << "=" << g << " nothing to do.\n----Multiplication done----"<<endl;
       return g;
     }
 
-    if(g.size()==1 && g.front().front()==0){
-      g=gp;
+    if(g.isConstantOne()){
+      g.clear();
+      for(size_t i=from;i<to;i++){
+        g.addMonomial(gp.monomialBegin(i),gp.monomialEnd(i));
+      }
       //      cout << "=" << g << " nothing to do.\n----Multiplication done----"<<endl;
       return g;
     }
@@ -174,55 +168,22 @@ namespace kryptoSAT{
     //actual multiplication
     //    cout << "non trivial multiplication"<<endl;
 
-    list<list<unsigned int>> l;
+    flatANF l;
     l.swap(g);
+    size_t gpEntries = gp.monomialBegin(to)-gp.monomialBegin(from);
+    g.reserve((to-from)*l.size(), gpEntries*l.size() + l.getNumberOfEntries()*(to-from));
 
-
-    for(list<list<unsigned int>>::const_iterator i=gp.begin();i!=gp.end();i++){
-      for(list<list<unsigned int>>::const_iterator j=l.begin();j!=l.end();j++){
-
+    for(size_t i=from;i<to;i++){
+      for(size_t j=0;j<l.size();j++){
         //product of two conjunctions of literals
-
-        ///     cout << "multiply " << *i << " * " << *j <<endl;
-
-        //check if one factor is 1
-        list<unsigned int> prod(*i);
-        if((*i).front()==0){
-          prod=list<unsigned int>(*j);
-        }else if((*j).front() != 0){
-          //if not, multiply
-
-          for(list<unsigned int>::const_iterator lit2=(*j).begin();lit2!=(*j).end();lit2++){
-            list<unsigned int>::iterator lit1=prod.begin();
-            while(lit1!=prod.end() && *lit1<*lit2){
-              lit1++;
-            }
-            if(lit1 == prod.end() || *lit1 > *lit2){
-              lit1=prod.insert(lit1,*lit2);
-            }
-          }
-        }
-
-        //      cout << "Product " << prod <<endl;
-
-        //add product to big sum
-        if(sortResult){
-          list<list<unsigned int>>::iterator k=g.begin();
-          while(k!=g.end() && *k < prod)
-            k++;
-          if(k==g.end() || *k > prod){
-            k=g.insert(k,prod);
-          }else{
-            k=g.erase(k);
-          }
-        }else{
-          g.push_back(prod);
-        }
-
-        //      cout << "current sum " << g <<endl;
+        g.addProduct(gp,i,l,j);
       }
     }
 
+    if(sortResult){
+      g.sort(false);
+    }
+
     //    cout << "Product: "<< g <<endl;
     //    cout << "-----Multiplication done-----"<<endl;
     return g;
@@ -233,18 +194,34 @@ namespace kryptoSAT{
   /// generated function given by the sum (XOR) of the two.
   /// Resulting ANF and inputs are (to be) ordered
   /// return equals modified first argument
-  list<list<unsigned int>>& addToANF(list<list<unsigned int>>& g,const list<list<unsigned int>>& gp){
+  flatANF& addToANF(flatANF& g,const flatANF& gp){
 
     //    cout << "----Adding ----\n" << g << "\n+\n" << gp <<endl;
 
-    list<list<unsigned int>>::iterator j=g.begin();
-    for(list<list<unsigned int>>::const_iterator i=gp.begin();i!=gp.end();i++){
-      while(j!=g.end() && *j < *i)
+    flatANF l;
+    l.swap(g);
+    g.reserve(l.size()+gp.size(), l.getNumberOfEntries()+gp.getNumberOfEntries());
+
+    size_t i=0;
+    size_t j=0;
+    while(i<l.size() || j<gp.size()){
+      int c;
+      if(i==l.size()){
+        c=1;
+      }else if(j==gp.size()){
+        c=-1;
+      }else{
+        c=flatANF::compareMonomials(l,i,gp,j);
+      }
+      if(c<0){
+        g.addMonomial(l.monomialBegin(i),l.monomialEnd(i));
+        i++;
+      }else if(c>0){
+        g.addMonomial(gp.monomialBegin(j),gp.monomialEnd(j));
         j++;
-      if(j==g.end() || *j > *i){
-        j=g.insert(j,*i);
       }else{
-        j=g.erase(j);
+        i++;
+        j++;
       }
     }
 
@@ -255,8 +232,8 @@ namespace kryptoSAT{
 
 
   /// several concats followed by sortANF are equivalent to several additions
-  list<list<unsigned int>>& concatANF(list<list<unsigned int>>& g,const list<list<unsigned int>>& gp){
-    g.insert(g.end(),gp.begin(),gp.end());
+  flatANF& concatANF(flatANF& g,const flatANF& gp){
+    g.append(gp);
     return g;
   }
 
@@ -267,50 +244,140 @@ namespace kryptoSAT{
 
   /// if subSort: sort all summands (if !subSort, these need to be already sorted)
   /// sort sum and delete matching pairs (XOR)
-  list<list<unsigned int>>& sortANF(list<list<unsigned int>>& g, bool subSort=true){
-    if(subSort){
-      for(list<list<unsigned int>>::iterator i=g.begin();i!=g.end();i++){
-        i->sort();
+  flatANF& sortANF(flatANF& g, bool subSort=true){
+    g.sort(subSort);
+    return g;
+  }
+
+
+
+
+  //////////////////////////////////////////////////////////////////////////
+
+  /// The public key as encrypt() uses it: every clause negated and
+  /// brought into ANF, together with the variables it depends on, both
+  /// indexed by the clause number in the key. Everything lives in flat
+  /// arrays. Preparing is done once per key, all bits (and threads) of
+  /// a message then only index into it.
+  class preparedPublicKey{
+
+  protected:
+    size_t nbrOfVars;
+    /// monomials [negatedStart[c],negatedStart[c+1]) of negated are NOT clause c
+    flatANF negated;
+    vector<size_t> negatedStart;
+    /// variables [dependsStart[c],dependsStart[c+1]) of depends are those of clause c
+    vector<unsigned int> depends;
+    vector<size_t> dependsStart;
+    size_t maxClauseSize;
+
+  public:
+
+    /// Caution: expects the public key in canonical order (flatCNF::sort()) for the numbering of clauses to be consistent!
+    preparedPublicKey(const flatCNF* publicKey, size_t privateKeyLength):nbrOfVars(privateKeyLength),negatedStart(1,0),dependsStart(1,0),maxClauseSize(0){
+      negatedStart.reserve(publicKey->size()+1);
+      dependsStart.reserve(publicKey->size()+1);
+      depends.reserve(publicKey->getNumberOfLiterals());
+
+      for(size_t c=0;c<publicKey->size();c++){
+        flatANF nClause;
+        nClause.addConstant();
+
+        for(const int* lit=publicKey->clauseBegin(c); lit!=publicKey->clauseEnd(c);lit++){
+          int V =*lit;
+          flatANF cur;
+          unsigned int absV = V>0 ? V : -V;
+
+          if(V>0){
+            cur.addConstant();
+          }
+          cur.addMonomial(&absV,&absV+1);
+          depends.push_back(absV);
+
+          multiplyToANF(nClause,cur);
+        }
+
+        negated.append(nClause);
+        negatedStart.push_back(negated.size());
+        dependsStart.push_back(depends.size());
+        maxClauseSize=max(maxClauseSize,publicKey->clauseSize(c));
       }
     }
-    //    cout << "sum sorting"<<endl;
-    g.sort(cmp);
-    //    cout <<"deleting"<<endl;
-    for(list<list<unsigned int>>::iterator i=g.begin();i!=g.end();){
-      if(next(i)!=g.end() && *next(i) == *i){
-        i=g.erase(i);
-        i=g.erase(i);
-      }else{
-        i++;
-      }
+
+    /// True iff windows of beta+1 clauses can be encrypted: beta>=1
+    /// (else the cipher is the plain bit) and the random functions of
+    /// beta-1 clauses have at most MAXRANDOMFUNCTIONVARS variables.
+    bool validBeta(size_t beta) const{
+      return beta>=1 && (beta-1)*maxClauseSize <= MAXRANDOMFUNCTIONVARS;
+    }
+
+    size_t getNumberOfVars() const{return nbrOfVars;}
+
+    /// number of clauses
+    size_t size() const{return negatedStart.size()-1;}
+
+    /// the negated clauses, clause c consists of the monomials [negatedBegin(c),negatedEnd(c))
+    const flatANF& getNegatedClauses() const{return negated;}
+    size_t negatedBegin(size_t c) const{return negatedStart[c];}
+    size_t negatedEnd(size_t c) const{return negatedStart[c+1];}
+
+    const unsigned int* dependsBegin(size_t c) const{return depends.data() + dependsStart[c];}
+    const unsigned int* dependsEnd(size_t c) const{return depends.data() + dependsStart[c+1];}
+
+  };
+
+
+  /// appends prefix*(random function of the variables [begin,end)) to re
+  void RandomFunction(rng * r,const unsigned int* begin,const unsigned int* end, vector<unsigned int>& prefix, flatANF& re){
+    if(r->randomBool()){
+      re.addMonomial(prefix.data(),prefix.data()+prefix.size());
+    }
+    for(const unsigned int* v=begin;v!=end;v++){
+      prefix.push_back(*v);
+      RandomFunction(r,v+1,end,prefix,re);
+      prefix.pop_back();
     }
-    return g;
   }
 
-  /// works on the list of variables but eventually leaves it unchanged
   /// return is sorted if variables are sorted
-  list<list<unsigned int>>* RandomFunction(rng * r,list<unsigned int> variables){
+  flatANF RandomFunction(rng * r,const vector<unsigned int>& variables){
     //    cout << "Generating random function depending on " << variables<<endl;
 
-    list<list<unsigned int>>* re = new list<list<unsigned int>>;
-    if(r->randomBool()){
-      re->push_back(list<unsigned int>(1,0));
-    }
-    for(list<unsigned int>::iterator v = variables.begin();v!=variables.end();){
-      unsigned int V=*v;
-      //      list<unsigned int>::iterator n = next(v);
-      v=variables.erase(v);
-      list<list<unsigned int>>* sub = RandomFunction(r,variables);
-      for(list<list<unsigned int>>::iterator subI=sub->begin(); subI!=sub->end(); subI++){
-        if(subI->front()==0){
-          *(subI->begin()) = V;
-        }else{
-          subI->push_front(V);
+    flatANF re;
+    vector<unsigned int> prefix;
+    prefix.reserve(variables.size());
+    RandomFunction(r,variables.data(),variables.data()+variables.size(),prefix,re);
+
+    return re;
+  }
+
+  /// Random function of the (sorted) variables as a bitmask over their
+  /// subsets: subset x (variable i is in x iff bit i of x is set) is a
+  /// summand iff bit x of the mask is set. The mask is drawn 64 bits at
+  /// a time. Return is sorted (within the monomials).
+  flatANF RandomFunctionBits(rng * r,const vector<unsigned int>& variables){
+    size_t d=variables.size();
+    size_t nbrSubsets=(size_t)1 << d;
+
+    flatANF re;
+    re.reserve(nbrSubsets/2+1,(nbrSubsets/2+1)*d);
+    vector<unsigned int> monomial(d);
+    for(size_t w=0;w*64<nbrSubsets;w++){
+      unsigned long long mask=r->randomBits();
+      if(nbrSubsets-w*64<64){
+        mask &= (1ULL << (nbrSubsets-w*64))-1;
+      }
+      while(mask!=0){
+        size_t subset=w*64+__builtin_ctzll(mask);
+        mask &= mask-1;
+        size_t l=0;
+        for(size_t i=0;i<d;i++){
+          if((subset>>i)&1){
+            monomial[l++]=variables[i];
+          }
         }
-        re->push_back(*subI);
+        re.addMonomial(monomial.data(),monomial.data()+l);
       }
-      delete sub;
-      //      v=variables.insert(n,V);
     }
 
     return re;
@@ -322,232 +389,481 @@ namespace kryptoSAT{
 
   //////////////////////////////////////////////////////////////////////////
 
-  /// Caution: expects sorted public key for the numbering of clauses to be consistent!
-  booleanFct<BFT_XOR>* encrypt(rng * r,const size_t& privateKeyLength, const booleanFct<BFT_AND>* publicKey, const bool& input, const size_t& beta_){
+  /// CPU time (ns, of the threads doing the work) spent in the phases
+  /// of encrypt() and the number of summands generated before
+  /// cancellation
+  struct encryptionTimers{
+    unsigned long long randomFunctions;
+    unsigned long long dependencies;
+    unsigned long long multiplication;
+    unsigned long long addition;
+    /// wall time of merging the partial sums of the threads
+    unsigned long long merge;
+    size_t monomials;
+
+    encryptionTimers():randomFunctions(0),dependencies(0),multiplication(0),addition(0),merge(0),monomials(0){}
+
+    void add(const encryptionTimers& t){
+      randomFunctions+=t.randomFunctions;
+      dependencies+=t.dependencies;
+      multiplication+=t.multiplication;
+      addition+=t.addition;
+      merge+=t.merge;
+      monomials+=t.monomials;
+    }
+  };
 
 
-    if(publicKey->size() > numeric_limits<unsigned int>::max() || privateKeyLength > (unsigned int)numeric_limits<int>::max()){
-      cerr << "ERR: fast encode is limited to int, i.e. key length " << std::numeric_limits<int>::max()<<endl;
-    }
+  /// Adds the cipher summand of window i, i.e. of the clauses
+  /// s[i],...,s[i+beta] of key, to gSum. Works on global variable
+  /// numbers, for windows of any size.
+  void encryptWindow(rng * r, unsigned int i, unsigned int beta, const preparedPublicKey& key, const unsigned int* s, unsigned int encoderVersion, anfAccumulator& gSum, encryptionTimers& timers){
+    unsigned int m = key.size();
+    unsigned long long start;
 
+    for(unsigned int j=0;j<beta;j++){
+      //      cout << "Generating R_{" << i << "," << j <<"}"<<endl;
 
-    unsigned int n=privateKeyLength;
-    unsigned int m = publicKey->size();
-    unsigned int beta=beta_;
-    bool Y = input;
+      start = threadCPUTime();
 
-    cout << "--------- Encryption --------"<<endl;
-    cout << "Encrypting: " << Y<<endl;
-    //    cout << "With public Key: " << publicKey->toString()<<endl;
-    cout << "n = " << n <<endl;
-    cout << "m = " << m <<endl;
-    cout << "beta = " << beta <<endl;
+      vector<unsigned int> Rdepends;
+      for(unsigned int k=0;k<beta;k++){
+        if(k!=j){
+          unsigned int c = s[(k+i)%m];
+          Rdepends.insert(Rdepends.end(),key.dependsBegin(c),key.dependsEnd(c));
+        }
+      }
+      //      cout << "gathered:" << Rdepends <<endl;
 
+      //delete doubles
+      sort(Rdepends.begin(),Rdepends.end());
+      Rdepends.erase(unique(Rdepends.begin(),Rdepends.end()),Rdepends.end());
+      timers.dependencies+=threadCPUTime()-start;
 
-    //cipher (level 1: XOR, level 2:AND)
-    list<list<unsigned int>> g;
+      start = threadCPUTime();
 
-    // generate a permutation of m elements
-    list<unsigned int> notUsed;
-    for(unsigned int i=0;i<m;i++){
-      notUsed.push_back(i);
-    }
+      flatANF R = encoderVersion<7 ? RandomFunction(r,Rdepends) : RandomFunctionBits(r,Rdepends);
 
-    unsigned int* s = new unsigned int[m];
-    for(unsigned int i=0;i<m;i++){
-      bool set=false;
-      unsigned int invProb=notUsed.size();
-      for(list<unsigned int>::iterator j=notUsed.begin();j!=notUsed.end()&&!set;){
-        if(r->randomInt(invProb)==0){
-          s[i]= *j;
-          j=notUsed.erase(j);
-          set=true;
-          continue;
-        }else{
-          j++;
-        }
-        invProb--;
-      }
+      timers.randomFunctions+=threadCPUTime()-start;
+
+      //        cout << "Generated random function " << R<<endl;
+
+      start = threadCPUTime();
+
+      unsigned int c = s[(i+beta)%m];
+      multiplyToANF(R,key.getNegatedClauses(),key.negatedBegin(c),key.negatedEnd(c),false);
+
+      timers.multiplication+=threadCPUTime()-start;
+      timers.monomials+=R.size();
+
+      start = threadCPUTime();
+
+      gSum.toggle(R);
+
+      timers.addition+=threadCPUTime()-start;
     }
+  }
 
-    /*
-      cout << "Permutation generated" << endl;
 
-      for(unsigned int i=0;i<m;i++){
-      cout << "s["<<i<<"]="<<s[i]<<endl;
+  /// Same as encryptWindow(), with the same random numbers and the same
+  /// result, for windows of at most 64 distinct variables: these are
+  /// numbered locally, such that every monomial is a bitmask and
+  /// multiplication is an OR. The summands of the window are summed up
+  /// locally and only the result is translated back to global
+  /// variables. The buffers are reused from window to window.
+  class windowKernel{
+
+  protected:
+    /// local variable b is vars[b], ascending
+    vector<unsigned int> vars;
+    /// variables of the first beta clauses of the window
+    vector<unsigned long long> depends;
+    /// monomials of the negated last clause of the window
+    vector<unsigned long long> clause;
+    /// monomials of the current random function
+    vector<unsigned long long> R;
+    /// the window's variables of the current random function
+    vector<unsigned long long> Rvars;
+    /// summands of the window, pairs cancel
+    vector<unsigned long long> terms;
+    vector<unsigned int> monomial;
+
+    unsigned long long localMask(const unsigned int* begin, const unsigned int* end) const{
+      unsigned long long re=0;
+      for(const unsigned int* v=begin;v!=end;v++){
+        re |= 1ULL << (lower_bound(vars.begin(),vars.end(),*v)-vars.begin());
       }
-    */
+      return re;
+    }
 
-    //ANF of clauses
-    //nClause[i] represents the s[i]-th negated clause in the public key
-    list<list<unsigned int>>* nClause= new list<list<unsigned int>>[m];
-    //list of variables on which nClause[i] depends
-    list<unsigned int>* depends = new list<unsigned int>[m];
-
-    //generate these lists
-    unsigned int cN=0;
-    for(list<BF*>::const_iterator k=publicKey->begin(); k!=publicKey->end();k++){
-      //inverse search
-      unsigned int i=0;
-      bool found=false;
-      for(; i<m && !found;i++){
-        if(s[i]==cN){
-          found=true;
-        }
+    /// as RandomFunction(r,begin,end,prefix,re), same random numbers
+    void randomFunction(rng * r, const unsigned long long* begin, const unsigned long long* end, unsigned long long prefix){
+      if(r->randomBool()){
+        R.push_back(prefix);
       }
-      i--;
-      if(!found){
-        cerr << "Error in permutation. No inverse of " << cN<<endl;
-        return 0;
+      for(const unsigned long long* v=begin;v!=end;v++){
+        randomFunction(r,v+1,end,prefix | *v);
       }
+    }
 
-
-      //  cout << "s^{-1}("<<cN<<")="<<i<<endl;
-
-      if(nClause[i].size()!=0 || depends[i].size()!=0){
-        cerr << "Error in permutation, clause exists."<<endl;
-        return 0;
+    /// as RandomFunctionBits(), same random numbers
+    void randomFunctionBits(rng * r){
+      size_t d=Rvars.size();
+      size_t nbrSubsets=(size_t)1 << d;
+      for(size_t w=0;w*64<nbrSubsets;w++){
+        unsigned long long mask=r->randomBits();
+        if(nbrSubsets-w*64<64){
+          mask &= (1ULL << (nbrSubsets-w*64))-1;
+        }
+        while(mask!=0){
+          size_t subset=w*64+__builtin_ctzll(mask);
+          mask &= mask-1;
+          unsigned long long x=0;
+          for(size_t i=0;subset!=0;i++,subset>>=1){
+            if(subset&1){
+              x |= Rvars[i];
+            }
+          }
+          R.push_back(x);
+        }
       }
+    }
 
+  public:
 
-      //        cout << "Converting " << (*k)->toString() <<endl;
+    /// Adds the cipher summand of window i to gSum, as
+    /// encryptWindow(). If the window has more than 64 variables,
+    /// nothing is done (and drawn) and false is returned.
+    bool encrypt(rng * r, unsigned int i, unsigned int beta, const preparedPublicKey& key, const unsigned int* s, unsigned int encoderVersion, anfAccumulator& gSum, encryptionTimers& timers){
+      unsigned int m = key.size();
+      unsigned long long start = threadCPUTime();
 
-      nClause[i].push_back(list<unsigned int>(1,0));//constant 1
+      vars.clear();
+      for(unsigned int k=0;k<=beta;k++){
+        unsigned int c = s[(k+i)%m];
+        vars.insert(vars.end(),key.dependsBegin(c),key.dependsEnd(c));
+      }
+      sort(vars.begin(),vars.end());
+      vars.erase(unique(vars.begin(),vars.end()),vars.end());
+      if(vars.size()>64){
+        timers.dependencies+=threadCPUTime()-start;
+        return false;
+      }
 
-      for(list<BF*>::const_iterator lit=(*k)->begin(); lit!=(*k)->end();lit++){
-        int V =(*lit)->getDependence();
+      depends.resize(beta);
+      for(unsigned int k=0;k<beta;k++){
+        unsigned int c = s[(k+i)%m];
+        depends[k]=localMask(key.dependsBegin(c),key.dependsEnd(c));
+      }
+      const flatANF& negated = key.getNegatedClauses();
+      unsigned int c = s[(i+beta)%m];
+      clause.clear();
+      for(size_t x=key.negatedBegin(c);x<key.negatedEnd(c);x++){
+        clause.push_back(localMask(negated.monomialBegin(x),negated.monomialEnd(x)));
+      }
+      timers.dependencies+=threadCPUTime()-start;
 
-        //      cout << "Literal " << (*lit)->toString()<< " = " <<V<<endl;
-        list<list<unsigned int>> cur;
+      terms.clear();
+      for(unsigned int j=0;j<beta;j++){
+        start = threadCPUTime();
+        unsigned long long Rdepends=0;
+        for(unsigned int k=0;k<beta;k++){
+          if(k!=j){
+            Rdepends |= depends[k];
+          }
+        }
+        //single bits, ascending, i.e. in the order of the global variables
+        Rvars.clear();
+        for(;Rdepends!=0;Rdepends &= Rdepends-1){
+          Rvars.push_back(Rdepends & (~Rdepends+1));
+        }
+        timers.dependencies+=threadCPUTime()-start;
 
-        if(V>0){
-          cur.push_back(list<unsigned int>(1,0));
-          cur.push_back(list<unsigned int>(1,V));
-          depends[i].push_back(V);
+        start = threadCPUTime();
+        R.clear();
+        if(encoderVersion<7){
+          randomFunction(r,Rvars.data(),Rvars.data()+Rvars.size(),0);
         }else{
-          cur.push_back(list<unsigned int>(1,-V));
-          depends[i].push_back(-V);
+          randomFunctionBits(r);
         }
+        timers.randomFunctions+=threadCPUTime()-start;
 
-        multiplyToANF(nClause[i],cur);
+        start = threadCPUTime();
+        for(size_t a=0;a<clause.size();a++){
+          for(size_t b=0;b<R.size();b++){
+            terms.push_back(clause[a] | R[b]);
+          }
+        }
+        timers.multiplication+=threadCPUTime()-start;
       }
-      //      cout << "negated clause: " << nClause[i]<<endl;
-      cN++;
-    }
+      timers.monomials+=terms.size();
+
+      start = threadCPUTime();
+      sort(terms.begin(),terms.end());
+      for(size_t a=0;a<terms.size();){
+        size_t b=a+1;
+        while(b<terms.size() && terms[b]==terms[a]){
+          b++;
+        }
+        if((b-a)%2==1){
+          monomial.clear();
+          for(unsigned long long x=terms[a];x!=0;x &= x-1){
+            monomial.push_back(vars[__builtin_ctzll(x)]);
+          }
+          gSum.toggle(monomial.data(),monomial.data()+monomial.size());
+        }
+        a=b;
+      }
+      timers.addition+=threadCPUTime()-start;
 
+      return true;
+    }
 
-    delete[] s;
+  };
 
-    //    cout << "Lists prepared"<<endl;
-    /*    cout << "negated clauses:" <<endl;
 
-          for(unsigned int i=0; i<m;i++){
-          cout << "c_s["<<i<<"] = " << nClause[i]<<endl;
-          cout << "depends on " << depends[i]<<endl;
-          }
-    */
+  /// Adds the cipher summands of the windows i in [from,to) to gSum,
+  /// where window i consists of the clauses s[i],...,s[i+beta] of key.
+  void encryptWindows(rng * r, unsigned int from, unsigned int to, unsigned int beta, const preparedPublicKey& key, const unsigned int* s, unsigned int encoderVersion, anfAccumulator& gSum, encryptionTimers& timers){
+    windowKernel kernel;
+    for(unsigned int i=from;i<to;i++){
+      //generate the cipher summand from the set of clauses (s[i], s[i+1],...,s[i+\beta])
+      if(!kernel.encrypt(r, i, beta, key, s, encoderVersion, gSum, timers)){
+        encryptWindow(r, i, beta, key, s, encoderVersion, gSum, timers);
+      }
+    }//next tuple
+  }
 
-    clock_t overall = clock();
-    size_t randomFunctionsTimer=0;
-    size_t dependenciesTimer=0;
-    size_t multiplicationTimer=0;
-    size_t additionTimer=0;
 
-    clock_t start;
-    for(unsigned int i=0;i<m;i++){
-      //generate the cipher summand from the set of clauses (s[i], s[i+1],...,s[i+\beta])
+  /// A new generator as the given encoder version uses it: of the
+  /// kind of prototype up to version 8, from version 8 on behind a
+  /// pooledRNG and from version 9 on a chachaRNG. For version 8 a
+  /// pooled prototype is already of the right kind, version 9 ignores
+  /// the kind of the prototype. The streaming version uses a plain
+  /// chachaRNG.
+  rng* spawnEncoderRNG(const rng* prototype, unsigned int encoderVersion){
+    if(encoderVersion==STREAMINGENCODERVERSION){
+      return new chachaRNG();
+    }
+    if(encoderVersion<8 || (encoderVersion==8 && dynamic_cast<const pooledRNG*>(prototype)!=0)){
+      return prototype->spawn();
+    }
+    if(encoderVersion<9){
+      return new pooledRNG(prototype->spawn());
+    }
+    return new pooledRNG(new chachaRNG());
+  }
 
-      for(unsigned int j=0;j<beta;j++){
-        //      cout << "Generating R_{" << i << "," << j <<"}"<<endl;
 
-        start = clock();
+  /// Worker for encoder version >= 4: takes the next block of
+  /// WINDOWBLOCKSIZE windows until all are done and encrypts block b
+  /// with the sub-stream b of windowSeed. Generators are spawned from
+  /// prototype.
+  void encryptWindowBlocksWorker(const rng* prototype, size_t windowSeed, unsigned int beta, const preparedPublicKey* key, const unsigned int* s, unsigned int encoderVersion, atomic<size_t>* nextBlock, anfAccumulator* gSum, encryptionTimers* timers){
+    rng* r = spawnEncoderRNG(prototype,encoderVersion);
+    unsigned int m = key->size();
+    size_t nbrBlocks = (m+WINDOWBLOCKSIZE-1)/WINDOWBLOCKSIZE;
+    for(size_t b=(*nextBlock)++; b<nbrBlocks; b=(*nextBlock)++){
+      r->seed(windowSeed,b);
+      unsigned int to = (b+1)*WINDOWBLOCKSIZE < m ? (b+1)*WINDOWBLOCKSIZE : m;
+      encryptWindows(r, b*WINDOWBLOCKSIZE, to, beta, *key, s, encoderVersion, *gSum, *timers);
+    }
+    delete r;
+  }
 
-        list<unsigned int> Rdepends;
-        for(unsigned int k=0;k<beta;k++){
-          if(k!=j){
-            //      cout << "inserting " << depends[(k+i)%m]<<endl;
-            Rdepends.insert(Rdepends.end(),depends[(k+i)%m].begin(),depends[(k+i)%m].end());
-          }
-        }
-        //      cout << "gathered:" << Rdepends <<endl;
+  /// Draws a random permutation s of [0,m). Up to encoder version 5
+  /// every element is picked by walking the list of the unused ones,
+  /// which takes O(m^2) random numbers, later versions shuffle.
+  void drawPermutation(rng* r, unsigned int m, unsigned int encoderVersion, unsigned int* s){
+    if(encoderVersion<6){
+      list<unsigned int> notUsed;
+      for(unsigned int i=0;i<m;i++){
+        notUsed.push_back(i);
+      }
 
-        //delete doubles
-        Rdepends.sort();
-        for(list<unsigned int>::iterator i=Rdepends.begin();i!=Rdepends.end();){
-          if(next(i)!=Rdepends.end() && *next(i)==*i){
-            i=Rdepends.erase(i);
+      for(unsigned int i=0;i<m;i++){
+        bool set=false;
+        unsigned int invProb=notUsed.size();
+        for(list<unsigned int>::iterator j=notUsed.begin();j!=notUsed.end()&&!set;){
+          if(r->randomInt(invProb)==0){
+            s[i]= *j;
+            j=notUsed.erase(j);
+            set=true;
+            continue;
           }else{
-            i++;
+            j++;
           }
+          invProb--;
         }
-        dependenciesTimer+=clock()-start;
+      }
+      return;
+    }
 
-        start = clock();
+    for(unsigned int i=0;i<m;i++){
+      s[i]=i;
+    }
+    for(unsigned int i=0;i+1<m;i++){
+      swap(s[i],s[i+r->randomInt(m-i)]);
+    }
+  }
 
-        list<list<unsigned int>>* R = RandomFunction(r,Rdepends);
 
-        randomFunctionsTimer+=clock()-start;
+  /// g+=gp, gp is emptied
+  void mergeAccumulators(anfAccumulator* g, anfAccumulator* gp){
+    g->toggle(*gp);
+    gp->clear();
+  }
+
+
+
+
+  //////////////////////////////////////////////////////////////////////////
 
-        //sortANF(*R);
+  /// With encoder version >= 4 the windows are spread over nbrThreads
+  /// threads, the result does not depend on their number.
+  /// The cipher is returned in ANF, return indicates success.
+  bool encrypt(rng * r, const preparedPublicKey& publicKey, const bool& input, const size_t& beta_, flatANF& cipher, unsigned int encoderVersion=ENCODERVERSION, unsigned int nbrThreads=1){
 
-        //        cout << "Generated random function " << *R<<endl;
 
-        start = clock();
+    if(publicKey.size() > numeric_limits<unsigned int>::max() || publicKey.getNumberOfVars() > (unsigned int)numeric_limits<int>::max()){
+      LOG_ERROR("fast encode is limited to int, i.e. key length " << std::numeric_limits<int>::max());
+    }
+    if(!publicKey.validBeta(beta_)){
+      LOG_ERROR("beta = " << beta_ << " is out of range for this key.");
+      return false;
+    }
+
+
+    unsigned int n = publicKey.getNumberOfVars();
+    unsigned int m = publicKey.size();
+    unsigned int beta=beta_;
+    bool Y = input;
+
+    LOG_DEBUG("--------- Encryption --------");
+    LOG_DEBUG("Encrypting: " << Y);
+    //    cout << "With public Key: " << publicKey->toString()<<endl;
+    LOG_DEBUG("n = " << n);
+    LOG_DEBUG("m = " << m);
+    LOG_DEBUG("beta = " << beta);
 
-        multiplyToANF(*R,nClause[(i+beta)%m],false);
 
-        multiplicationTimer+=clock()-start;
+    //cipher (level 1: XOR, level 2:AND)
+    flatANF g;
+    //sum of all window products, pairs cancel on insertion
+    anfAccumulator gSum;
 
-        start = clock();
+    // generate a permutation of m elements
+    unsigned int* s = new unsigned int[m];
+    drawPermutation(r, m, encoderVersion, s);
 
-        //        addToANF(g,*R);
-        concatANF(g,*R);
+    /*
+      LOG_DEBUG("Permutation generated");
 
-        additionTimer+=clock()-start;
+      for(unsigned int i=0;i<m;i++){
+      LOG_DEBUG("s["<<i<<"]="<<s[i]);
+      }
+    */
 
-        delete R;
+    unsigned long long overall = wallTime();
+    encryptionTimers timers;
+
+    if(encoderVersion<4){
+      encryptWindows(r, 0, m, beta, publicKey, s, encoderVersion, gSum, timers);
+    }else{
+      //each block of windows gets its own sub-stream of windowSeed
+      size_t windowSeed = r->randomInt(numeric_limits<size_t>::max());
+      size_t nbrBlocks = (m+WINDOWBLOCKSIZE-1)/WINDOWBLOCKSIZE;
+      if(nbrThreads<1){
+        nbrThreads=1;
+      }
+      if(nbrThreads>nbrBlocks){
+        nbrThreads=nbrBlocks;
       }
-    }//next tuple
 
-    start = clock();
-    sortANF(g,false);
-    additionTimer+=clock()-start;
+      atomic<size_t> nextBlock(0);
+      //partial sums, the first one is gSum
+      vector<anfAccumulator> partial(nbrThreads-1);
+      vector<encryptionTimers> partialTimers(nbrThreads-1);
+      vector<thread> workers;
+      for(unsigned int t=0;t+1<nbrThreads;t++){
+        workers.push_back(thread(encryptWindowBlocksWorker, r, windowSeed, beta, &publicKey, s, encoderVersion, &nextBlock, &partial[t], &partialTimers[t]));
+      }
+      encryptWindowBlocksWorker(r, windowSeed, beta, &publicKey, s, encoderVersion, &nextBlock, &gSum, &timers);
+      for(size_t t=0;t<workers.size();t++){
+        workers[t].join();
+        timers.add(partialTimers[t]);
+      }
 
+      //wall time, the merging threads are short lived
+      unsigned long long start = wallTime();
+      //pairwise merging, the levels of the tree in parallel
+      vector<anfAccumulator*> sums(1,&gSum);
+      for(size_t t=0;t<partial.size();t++){
+        sums.push_back(&partial[t]);
+      }
+      for(size_t step=1;step<sums.size();step*=2){
+        vector<thread> mergers;
+        for(size_t t=0;t+step<sums.size();t+=2*step){
+          mergers.push_back(thread(mergeAccumulators, sums[t], sums[t+step]));
+        }
+        for(size_t t=0;t<mergers.size();t++){
+          mergers[t].join();
+        }
+      }
+      timers.merge+=wallTime()-start;
+    }
 
-    cout << "Encryption done in\t\t\t" << 1000.0 * (clock()-overall) / CLOCKS_PER_SEC  << " ms"<<endl;
-    cout << "There of:\trandom functions: \t" << 1000.0 * randomFunctionsTimer / CLOCKS_PER_SEC  << " ms"<<endl;
-    cout << "\t\tdependency lists: \t" << 1000.0 * dependenciesTimer / CLOCKS_PER_SEC  << " ms"<<endl;
-    cout << "\t\tANF multiplication: \t" << 1000.0 * multiplicationTimer / CLOCKS_PER_SEC  << " ms"<<endl;
-    cout << "\t\tANF addition: \t\t" << 1000.0 * additionTimer / CLOCKS_PER_SEC  << " ms"<<endl;
+    unsigned long long start = threadCPUTime();
+    //canonical order, identical to concatANF + sortANF(g,false)
+    gSum.extract(g,true);
+    gSum.clear();
+    timers.addition+=threadCPUTime()-start;
+
+    unsigned long long wall = wallTime()-overall;
+    metricsRegistry& M = metrics();
+    M.addSample("encryptBit",wall/1e6);
+    M.addPhase("encrypt.randomFunctions",0,timers.randomFunctions);
+    M.addPhase("encrypt.dependencies",0,timers.dependencies);
+    M.addPhase("encrypt.multiplication",0,timers.multiplication);
+    M.addPhase("encrypt.addition",0,timers.addition);
+    M.addPhase("encrypt.merge",timers.merge,0);
+    M.count("encrypt.monomialsGenerated",timers.monomials);
+    M.count("encrypt.monomialsCipher",g.size());
+    M.max("encrypt.peakCipherMonomials",g.size());
+    M.max("encrypt.peakCipherEntries",g.getNumberOfEntries());
+
+    LOG_DEBUG("Encryption done in\t\t\t" << wall/1e6 << " ms");
+    LOG_DEBUG("There of (CPU):\trandom functions: \t" << timers.randomFunctions/1e6 << " ms");
+    LOG_DEBUG("\t\tdependency lists: \t" << timers.dependencies/1e6 << " ms");
+    LOG_DEBUG("\t\tANF multiplication: \t" << timers.multiplication/1e6 << " ms");
+    LOG_DEBUG("\t\tANF addition: \t\t" << timers.addition/1e6 << " ms");
+    LOG_DEBUG("(wall):\t\tmerging partial sums: \t" << timers.merge/1e6 << " ms");
 
 
-    delete[] nClause;
-    delete[] depends;
+    delete[] s;
 
 
     // Y to ANF
     if(Y){
-      addToANF(g,list<list<unsigned int>>(1,list<unsigned int>(1,0)));
+      flatANF one;
+      one.addConstant();
+      addToANF(g,one);
     }
 
-    cout << "Converting back to usual representation"<<endl;
+    cipher.swap(g);
 
-    booleanFct<BFT_XOR>* re= new booleanFct<BFT_XOR>(n);
+    LOG_DEBUG("--------- Encryption done --------");
+    //    cout << "Cipher = " <<cipher<<endl;
+    return true;
+  }
 
-    for(list<list<unsigned int>>::const_iterator i=g.begin();i!=g.end();i++){
-      re->push_back(new booleanFct<BFT_AND>(n));
-      for(list<unsigned int>::const_iterator j=(*i).begin();j!=(*i).end();j++){
-        if(*j==0){
-          re->back()->push_back(new booleanFct<BFT_TRUE>(n));
-        }else{
-          re->back()->push_back(new booleanFct<BFT_INPUT>(n,*j - 1));
-        }
-      }
-    }
 
-    cout << "--------- Encryption done --------"<<endl;
-    //    cout << "Cipher = " <<g->toString()<<endl;
-    return re;
+  /// Caution: expects the public key in canonical order (flatCNF::sort()) for the numbering of clauses to be consistent!
+  /// Prepares the key for this bit only, to encrypt several bits use
+  /// encrypt(r,preparedPublicKey,...).
+  bool encrypt(rng * r,const size_t& privateKeyLength, const flatCNF* publicKey, const bool& input, const size_t& beta_, flatANF& cipher, unsigned int encoderVersion=ENCODERVERSION, unsigned int nbrThreads=1){
+    preparedPublicKey key(publicKey,privateKeyLength);
+    return encrypt(r, key, input, beta_, cipher, encoderVersion, nbrThreads);
   }
 
 
@@ -0,0 +1,285 @@
+/*****************************************************************************
+ *
+ * @file flatANF.h
+ *
+ * @section DESCRIPTION
+ *
+ * Packed representation of a function in algebraic normal form (XOR
+ * of conjunctions of variables) as used by the encryption engine. All
+ * variable numbers live in one buffer and the monomials are given by
+ * offsets into it.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#ifndef FLATANF_H
+#define FLATANF_H
+
+#include <vector>
+#include <algorithm>
+
+
+
+/// ANF stored as one buffer of variable numbers plus monomial offsets.
+/// Monomial i is the conjunction of the variables
+/// [monomialBegin(i),monomialEnd(i)), numbered from 1 and (to be)
+/// sorted ascending. The empty monomial is the constant 1, the empty
+/// ANF is the constant 0.
+///
+/// Copying is explicit (clone()), the container itself can only be moved.
+class flatANF{
+
+ protected:
+  vector<unsigned int> vars;
+  /// monomialStart[i] is the offset of monomial i, the last entry is vars.size()
+  vector<size_t> monomialStart;
+
+
+  /// Sort key of a monomial: its first two variables, zero padded.
+  /// As variable numbers start with 1, comparing keys agrees with
+  /// compareMonomials() up to ties.
+  struct sortKey{
+    unsigned long long prefix;
+    size_t monomial;
+  };
+
+  struct sortKeyLess{
+    const flatANF* anf;
+    sortKeyLess(const flatANF* _anf):anf(_anf){}
+    bool operator()(const sortKey& x, const sortKey& y) const{
+      if(x.prefix!=y.prefix){
+        return x.prefix<y.prefix;
+      }
+      return anf->compareMonomials(x.monomial,y.monomial)<0;
+    }
+  };
+
+  sortKey getSortKey(size_t i) const{
+    sortKey re;
+    re.monomial=i;
+    size_t l=monomialSize(i);
+    const unsigned int* v=monomialBegin(i);
+    re.prefix = ((unsigned long long)(l>0 ? v[0] : 0) << 32) | (l>1 ? v[1] : 0);
+    return re;
+  }
+
+
+ public:
+
+  flatANF():monomialStart(1,0){}
+
+  flatANF(flatANF&& f):vars(),monomialStart(1,0){swap(f);}
+
+  flatANF& operator=(flatANF&& f){
+    swap(f);
+    return *this;
+  }
+
+  flatANF(const flatANF&) = delete;
+  flatANF& operator=(const flatANF&) = delete;
+
+  flatANF clone() const{
+    flatANF re;
+    re.vars=vars;
+    re.monomialStart=monomialStart;
+    return re;
+  }
+
+  void swap(flatANF& f){
+    vars.swap(f.vars);
+    monomialStart.swap(f.monomialStart);
+  }
+
+
+  /// number of monomials (summands)
+  size_t size() const{return monomialStart.size()-1;}
+
+  /// total number of variable entries over all monomials
+  size_t getNumberOfEntries() const{return vars.size();}
+
+  const unsigned int* monomialBegin(size_t i) const{return vars.data() + monomialStart[i];}
+  const unsigned int* monomialEnd(size_t i) const{return vars.data() + monomialStart[i+1];}
+  size_t monomialSize(size_t i) const{return monomialStart[i+1]-monomialStart[i];}
+
+  bool isConstantOne() const{return size()==1 && monomialSize(0)==0;}
+
+  void reserve(size_t nbrMonomials, size_t nbrEntries){
+    monomialStart.reserve(nbrMonomials+1);
+    vars.reserve(nbrEntries);
+  }
+
+  /// append the monomial given by the variables [begin,end)
+  void addMonomial(const unsigned int* begin, const unsigned int* end){
+    vars.insert(vars.end(),begin,end);
+    monomialStart.push_back(vars.size());
+  }
+
+  /// append the constant summand 1
+  void addConstant(){
+    monomialStart.push_back(vars.size());
+  }
+
+  /// append the product of the monomial i of x and the monomial j of
+  /// y, i.e. the union of their (sorted) variables
+  void addProduct(const flatANF& x, size_t i, const flatANF& y, size_t j){
+    const unsigned int* a=x.monomialBegin(i);
+    const unsigned int* aEnd=x.monomialEnd(i);
+    const unsigned int* b=y.monomialBegin(j);
+    const unsigned int* bEnd=y.monomialEnd(j);
+    while(a!=aEnd && b!=bEnd){
+      if(*a<*b){
+        vars.push_back(*a++);
+      }else if(*b<*a){
+        vars.push_back(*b++);
+      }else{
+        vars.push_back(*a++);
+        b++;
+      }
+    }
+    vars.insert(vars.end(),a,aEnd);
+    vars.insert(vars.end(),b,bEnd);
+    monomialStart.push_back(vars.size());
+  }
+
+  /// append all monomials of f
+  void append(const flatANF& f){
+    size_t offset=vars.size();
+    vars.insert(vars.end(),f.vars.begin(),f.vars.end());
+    for(size_t i=1;i<f.monomialStart.size();i++){
+      monomialStart.push_back(offset+f.monomialStart[i]);
+    }
+  }
+
+  void clear(){
+    vars.clear();
+    monomialStart.assign(1,0);
+  }
+
+
+  /// lexicographic order on the (sorted) monomials, a proper prefix
+  /// is smaller. In particular the constant 1 comes first.
+  int compareMonomials(size_t i, size_t j) const{
+    return compareMonomials(*this,i,*this,j);
+  }
+
+  static int compareMonomials(const flatANF& x, size_t i, const flatANF& y, size_t j){
+    const unsigned int* a=x.monomialBegin(i);
+    const unsigned int* aEnd=x.monomialEnd(i);
+    const unsigned int* b=y.monomialBegin(j);
+    const unsigned int* bEnd=y.monomialEnd(j);
+    for(;a!=aEnd && b!=bEnd;a++,b++){
+      if(*a<*b){
+        return -1;
+      }
+      if(*a>*b){
+        return 1;
+      }
+    }
+    if(a!=aEnd){
+      return 1;
+    }
+    if(b!=bEnd){
+      return -1;
+    }
+    return 0;
+  }
+
+
+  /// If subSort: sort the variables in every monomial first (if
+  /// !subSort these need to be already sorted). Then sort the sum and
+  /// delete matching pairs (XOR).
+  void sort(bool subSort=true){
+    if(subSort){
+      for(size_t i=0;i<size();i++){
+        std::sort(vars.begin()+monomialStart[i],vars.begin()+monomialStart[i+1]);
+      }
+    }
+
+    vector<sortKey> order(size());
+    for(size_t i=0;i<order.size();i++){
+      order[i]=getSortKey(i);
+    }
+    std::sort(order.begin(),order.end(),sortKeyLess(this));
+
+    vector<unsigned int> sorted;
+    sorted.reserve(vars.size());
+    vector<size_t> sortedStart(1,0);
+    sortedStart.reserve(monomialStart.size());
+    for(size_t i=0;i<order.size();){
+      //length of the run of equal monomials
+      size_t j=i+1;
+      while(j<order.size() && order[i].prefix==order[j].prefix && compareMonomials(order[i].monomial,order[j].monomial)==0){
+        j++;
+      }
+      if((j-i)%2==1){
+        sorted.insert(sorted.end(),monomialBegin(order[i].monomial),monomialEnd(order[i].monomial));
+        sortedStart.push_back(sorted.size());
+      }
+      i=j;
+    }
+    vars.swap(sorted);
+    monomialStart.swap(sortedStart);
+  }
+
+
+  /// Notation as in the list based ANF: the constant 1 is printed as (0).
+  string toString() const{
+    stringstream re;
+    re << "(";
+    for(size_t i=0;i<size();i++){
+      re << "(";
+      if(monomialSize(i)==0){
+        re << 0;
+      }
+      for(const unsigned int* v=monomialBegin(i);v!=monomialEnd(i);v++){
+        re << *v;
+        if(v+1!=monomialEnd(i)){
+          re << ", ";
+        }
+      }
+      re << ")";
+      if(i+1<size()){
+        re << ", ";
+      }
+    }
+    re << ")";
+    return re.str();
+  }
+
+};
+
+
+#endif
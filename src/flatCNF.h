@@ -0,0 +1,313 @@
+/*****************************************************************************
+ *
+ * @file flatCNF.h
+ *
+ * @section DESCRIPTION
+ *
+ * Flat, contiguous representation of a function in conjunctive normal
+ * form as used for the public keys. All literals live in one array
+ * and the clauses are given by offsets into it, hence a key can be
+ * evaluated in a single linear scan.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+#ifndef FLATCNF_H
+#define FLATCNF_H
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+
+
+/// CNF stored as one literal array plus clause offsets.
+/// Literals are signed ints in the DIMACS convention, i.e. v>0 stands
+/// for variable v and -v for NOT v (variable numbers start with 1).
+/// Clause i consists of the literals [clauseBegin(i),clauseEnd(i)).
+class flatCNF{
+
+ protected:
+  size_t nbrOfVars;
+  vector<int> literals;
+  /// clauseStart[i] is the offset of clause i, the last entry is literals.size()
+  vector<size_t> clauseStart;
+
+
+  /// for ordering the clauses, cf. compare(BF*,BF*): shorter clauses
+  /// first, then lexicographic in the literals.
+  int compareClauses(size_t i, size_t j) const{
+    if(clauseSize(i) != clauseSize(j)){
+      return clauseSize(i) < clauseSize(j) ? -1 : 1;
+    }
+    for(const int *x=clauseBegin(i), *y=clauseBegin(j); x!=clauseEnd(i); x++,y++){
+      if(literalLess(*x,*y)){
+        return -1;
+      }
+      if(literalLess(*y,*x)){
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  /// position of a literal in the order literalLess()
+  unsigned long long literalRank(const int& x) const{
+    return x>0 ? x : nbrOfVars + (-x);
+  }
+
+  /// Sort key of a clause: its length and its first two literals
+  /// (by rank, zero padded). Comparing keys agrees with
+  /// compareClauses() up to ties, these are broken by the full
+  /// comparison and then the index, i.e. sorting keys is stable.
+  struct sortKey{
+    size_t length;
+    unsigned long long prefix;
+    size_t clause;
+  };
+
+  struct sortKeyLess{
+    const flatCNF* cnf;
+    sortKeyLess(const flatCNF* _cnf):cnf(_cnf){}
+    bool operator()(const sortKey& x, const sortKey& y) const{
+      if(x.length!=y.length){
+        return x.length<y.length;
+      }
+      if(x.prefix!=y.prefix){
+        return x.prefix<y.prefix;
+      }
+      int c=cnf->compareClauses(x.clause,y.clause);
+      if(c!=0){
+        return c<0;
+      }
+      return x.clause<y.clause;
+    }
+  };
+
+  sortKey getSortKey(size_t i) const{
+    sortKey re;
+    re.clause=i;
+    re.length=clauseSize(i);
+    const int* l=clauseBegin(i);
+    re.prefix = ((re.length>0 ? literalRank(l[0]) : 0) << 32) | (re.length>1 ? literalRank(l[1]) : 0);
+    return re;
+  }
+
+  /// sorts the literals of the clauses [from,to) and their keys
+  void sortRange(sortKey* keys, size_t from, size_t to){
+    for(size_t i=from;i<to;i++){
+      std::sort(literals.begin()+clauseStart[i],literals.begin()+clauseStart[i+1],literalLess);
+      keys[i]=getSortKey(i);
+    }
+    std::sort(keys+from,keys+to,sortKeyLess(this));
+  }
+
+  void mergeRanges(sortKey* keys, size_t from, size_t middle, size_t to){
+    inplace_merge(keys+from,keys+middle,keys+to,sortKeyLess(this));
+  }
+
+
+ public:
+
+  /// ordering of literals consistent with compare(BF*,BF*) on
+  /// BFT_INPUT/BFT_NOT leaves: all positive literals first, each
+  /// group ordered by variable number.
+  static bool literalLess(const int& x, const int& y){
+    if((x<0) != (y<0)){
+      return y<0;
+    }
+    return (x<0 ? -x : x) < (y<0 ? -y : y);
+  }
+
+  flatCNF(size_t _nbrOfVars):nbrOfVars(_nbrOfVars),clauseStart(1,0){}
+
+  size_t getNumberOfVars() const{return nbrOfVars;}
+
+  /// number of clauses
+  size_t size() const{return clauseStart.size()-1;}
+
+  size_t getNumberOfLiterals() const{return literals.size();}
+
+  const int* clauseBegin(size_t i) const{return literals.data() + clauseStart[i];}
+  const int* clauseEnd(size_t i) const{return literals.data() + clauseStart[i+1];}
+  size_t clauseSize(size_t i) const{return clauseStart[i+1]-clauseStart[i];}
+
+  void reserve(size_t nbrClauses, size_t nbrLiterals){
+    clauseStart.reserve(nbrClauses+1);
+    literals.reserve(nbrLiterals);
+  }
+
+  /// append the clause given by the literals [begin,end)
+  void addClause(const int* begin, const int* end){
+    literals.insert(literals.end(),begin,end);
+    clauseStart.push_back(literals.size());
+  }
+
+  /// append nbrClauses clauses of length literals each, stored
+  /// consecutively at begin
+  void addClauses(const int* begin, size_t nbrClauses, size_t length){
+    literals.insert(literals.end(),begin,begin+nbrClauses*length);
+    for(size_t i=0;i<nbrClauses;i++){
+      clauseStart.push_back(clauseStart.back()+length);
+    }
+  }
+
+  /// true iff all clauses have the same size, which is stored in length
+  bool isUniform(size_t& length) const{
+    length = size()>0 ? clauseSize(0) : 0;
+    for(size_t i=1;i<size();i++){
+      if(clauseSize(i)!=length){
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void removeLastClause(){
+    clauseStart.pop_back();
+    literals.resize(clauseStart.back());
+  }
+
+  void clear(){
+    literals.clear();
+    clauseStart.assign(1,0);
+  }
+
+
+  /// true iff the clauses i and j consist of the same literals in the same order
+  bool equalClauses(size_t i, size_t j) const{
+    return clauseSize(i)==clauseSize(j) && equal(clauseBegin(i),clauseEnd(i),clauseBegin(j));
+  }
+
+  /// Disjunction of the literals of clause i. Empty clauses are false.
+  bool evaluateClause(size_t i, const bool *const input) const{
+    for(const int* l=clauseBegin(i); l!=clauseEnd(i); l++){
+      if(*l>0 ? input[*l-1] : !input[-*l-1]){
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// conjunction of all clauses. If there are no clauses returns true.
+  bool evaluate(const bool *const input) const{
+    for(size_t i=0;i<size();i++){
+      if(!evaluateClause(i,input)){
+        return false;
+      }
+    }
+    return true;
+  }
+
+
+  /// Bring the CNF into canonical order, i.e. the order the
+  /// booleanFct<BFT_AND> representation assumes after
+  /// recursiveSort(). Encryption numbers the clauses in this order.
+  /// With nbrThreads>1 ranges of clauses are sorted in parallel and
+  /// merged, the result is the same.
+  void sort(unsigned int nbrThreads=1){
+    if(nbrThreads<1 || size()<nbrThreads*1024){
+      nbrThreads=1;
+    }
+    vector<sortKey> order(size());
+
+    //ranges [bounds[t],bounds[t+1]) sorted by thread t
+    vector<size_t> bounds(nbrThreads+1);
+    for(unsigned int t=0;t<=nbrThreads;t++){
+      bounds[t]=size()*t/nbrThreads;
+    }
+    vector<thread> workers;
+    for(unsigned int t=1;t<nbrThreads;t++){
+      workers.push_back(thread(&flatCNF::sortRange, this, order.data(), bounds[t], bounds[t+1]));
+    }
+    sortRange(order.data(),bounds[0],bounds[1]);
+    for(size_t t=0;t<workers.size();t++){
+      workers[t].join();
+    }
+
+    //merge neighbouring ranges pairwise
+    for(unsigned int width=1;width<nbrThreads;width*=2){
+      workers.clear();
+      for(unsigned int t=0;t+width<nbrThreads;t+=2*width){
+        size_t to = bounds[t+2*width < nbrThreads ? t+2*width : nbrThreads];
+        workers.push_back(thread(&flatCNF::mergeRanges, this, order.data(), bounds[t], bounds[t+width], to));
+      }
+      for(size_t t=0;t<workers.size();t++){
+        workers[t].join();
+      }
+    }
+
+    vector<int> sorted;
+    sorted.reserve(literals.size());
+    vector<size_t> sortedStart(1,0);
+    sortedStart.reserve(clauseStart.size());
+    for(size_t i=0;i<order.size();i++){
+      sorted.insert(sorted.end(),clauseBegin(order[i].clause),clauseEnd(order[i].clause));
+      sortedStart.push_back(sorted.size());
+    }
+    literals.swap(sorted);
+    clauseStart.swap(sortedStart);
+  }
+
+
+  string toString() const{
+    stringstream re;
+    re << "(";
+    for(size_t i=0;i<size();i++){
+      re << "(";
+      for(const int* l=clauseBegin(i); l!=clauseEnd(i); l++){
+        if(*l<0){
+          re << "!X" << -*l;
+        }else{
+          re << "X" << *l;
+        }
+        if(l+1!=clauseEnd(i)){
+          re << " OR ";
+        }
+      }
+      re << ")";
+      if(i+1<size()){
+        re << " AND ";
+      }
+    }
+    re << ")";
+    return re.str();
+  }
+
+};
+
+
+#endif
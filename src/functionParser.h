@@ -51,74 +51,242 @@
 #include <fstream>
 #include <string>
 #include <cstring>
+#include <climits>
+#include <cstdlib>
+#include <cstdio>
+#include <iterator>
 
 using namespace std;
 
 
 #include "booleanFct.h"
+#include "flatCNF.h"
+#include "flatANF.h"
+#include "mappedFile.h"
+#include "log.h"
+
+/// Binary key files start with one of these magics, followed by the
+/// rest of a binaryKeyHeader and the data.
+#define BINARYPUBLICKEYMAGIC "KRYPTOSAT-PUBKEY"
+#define BINARYPRIVATEKEYMAGIC "KRYPTOSAT-PRVKEY"
+#define BINARYKEYFORMAT 1
 
 namespace functionParser{
 
 
-  bool * readBool(const char * file, size_t& nbrVars){
+  /// Fixed size header of the binary key files (little endian). The
+  /// data follows directly: for public keys nbrClauses*clauseSize
+  /// literals as 32 bit ints in canonical clause order, for private
+  /// keys the bits packed into 64 bit words, variable i+1 is the bit
+  /// i%64 of word i/64.
+  struct binaryKeyHeader{
+    char magic[16];
+    unsigned int format;
+    /// literals per clause, 0 for private keys
+    unsigned int clauseSize;
+    unsigned long long nbrVars;
+    /// 0 for private keys
+    unsigned long long nbrClauses;
+  };
+
+  /// true iff [begin,end) starts with a binary key header with the given magic
+  bool isBinaryKey(const char* begin, const char* end, const char* magic){
+    return (size_t)(end-begin)>=sizeof(binaryKeyHeader) && memcmp(begin,magic,sizeof(binaryKeyHeader::magic))==0;
+  }
+
+  /// reads and checks the header of the binary key [begin,end), the
+  /// size of the data behind it is stored in dataSize
+  bool readBinaryKeyHeader(const char* begin, const char* end, binaryKeyHeader& header, size_t& dataSize){
+    memcpy(&header,begin,sizeof(header));
+    if(header.format!=BINARYKEYFORMAT){
+      LOG_ERROR("Unknown binary key format " << header.format);
+      return false;
+    }
+    dataSize=(end-begin)-sizeof(header);
+    return true;
+  }
 
-    ifstream inFile(file);
-    string line;
-    if (!inFile.is_open()){
-      cerr<< "ERR: could not open file" << file << " for reading." <<endl;
+  bool writeBinaryKeyHeader(ostream& out, const char* magic, size_t clauseSize, size_t nbrVars, size_t nbrClauses){
+    binaryKeyHeader header;
+    memcpy(header.magic,magic,sizeof(header.magic));
+    header.format=BINARYKEYFORMAT;
+    header.clauseSize=clauseSize;
+    header.nbrVars=nbrVars;
+    header.nbrClauses=nbrClauses;
+    out.write((const char*)&header,sizeof(header));
+    return out.good();
+  }
+
+
+  /// Private key from the binary format [begin,end), 0 on errors.
+  bool * readBinaryBool(const char* begin, const char* end, size_t& nbrVars){
+    binaryKeyHeader header;
+    size_t dataSize;
+    if(!readBinaryKeyHeader(begin,end,header,dataSize)){
+      return 0;
+    }
+    if(header.nbrVars > 8*dataSize || (header.nbrVars+63)/64*8 != dataSize){
+      LOG_ERROR("Binary key has the wrong size.");
       return 0;
     }
+    nbrVars=header.nbrVars;
+    const char* data=begin+sizeof(header);
+    bool* re = new bool[nbrVars];
+    for(size_t w=0;w*64<nbrVars;w++){
+      unsigned long long word;
+      memcpy(&word,data+8*w,8);
+      for(size_t b=0;b<64 && w*64+b<nbrVars;b++){
+        re[w*64+b] = (word>>b)&1;
+      }
+    }
+    return re;
+  }
+
+
+  bool writeBinaryBool(ostream& outFile, const bool*const B, const size_t& nbrVars){
+    if(!writeBinaryKeyHeader(outFile,BINARYPRIVATEKEYMAGIC,0,nbrVars,0)){
+      return false;
+    }
+    vector<unsigned long long> words((nbrVars+63)/64,0);
+    for(size_t i=0;i<nbrVars;i++){
+      if(B[i]){
+        words[i/64] |= 1ULL << (i%64);
+      }
+    }
+    outFile.write((const char*)words.data(),8*words.size());
+    return outFile.good();
+  }
+
+
+  /// Reads a bool array in the text format or the binary private key
+  /// format (detected by its magic) from the buffer [begin,end).
+  /// Returns 0 on format errors.
+  bool * readBool(const char* begin, const char* end, size_t& nbrVars){
+    if(isBinaryKey(begin,end,BINARYPRIVATEKEYMAGIC)){
+      return readBinaryBool(begin,end,nbrVars);
+    }
+    dimacsScanner in(begin,end);
+    const char *line, *lineEnd;
     bool* re=0;
-    while ( inFile.good() ){
-      getline(inFile,line);
-      //ignore empty/comment lines
-      if( line.size()>0 && line.at(0)!='c' && line.at(0)!='#' ){
-        if (re!=0){
-          cerr<<"Unrecognised file format!"<<endl;
-          return 0;
-        }
+    //first non comment line
+    while ( in.nextLine(line,lineEnd) ){
+      if (re!=0){
+        LOG_ERROR("Unrecognised file format!");
+        delete[] re;
+        return 0;
+      }
 
-	istringstream iss(line);
-	string token;
-	getline(iss, token, ' ');
-
-
-        if(token[0]=='0' || token[0]=='1'){
-          //simplest file format:
-          if(line.size()==1 || token[1]=='0' || token[1]=='1'){
-            //no spaces:
-            nbrVars=line.size();
-            re = new bool[nbrVars];
-            for(unsigned int i=0;i<line.size();i++){
-              if(token[i]=='1'){
-                re[i]=true;
-              }else{
-                re[i]=false;
-              }
-            }//next
-          }else{
-            //with spaces/commas/...
-            nbrVars=line.size()/2;
-            re = new bool[nbrVars];
-            for(unsigned int i=0;2*i<line.size();i++){
-              if(token[2*i]=='1'){
-                re[i]=true;
-              }else{
-                re[i]=false;
-              }
-            }//next
-          }
-        }//end if simple format
+      size_t length=lineEnd-line;
+      if(line[0]=='0' || line[0]=='1'){
+        //simplest file format:
+        if(length==1 || line[1]=='0' || line[1]=='1'){
+          //no spaces:
+          nbrVars=length;
+          re = new bool[nbrVars];
+          for(size_t i=0;i<length;i++){
+            re[i] = (line[i]=='1');
+          }//next
+        }else{
+          //with spaces/commas/...
+          nbrVars=length/2;
+          re = new bool[nbrVars];
+          for(size_t i=0;i<nbrVars;i++){
+            re[i] = (line[2*i]=='1');
+          }//next
+        }
+      }//end if simple format
 
-        //todo: advanced format ;)
+      //todo: advanced format ;)
 
-      }//end if comment
     }//wend
-    inFile.close();
     return re;
   }
 
 
+  bool * readBool(const char * file, size_t& nbrVars){
+    mappedFile inFile;
+    if (!inFile.open(file)){
+      LOG_ERROR("could not open file" << file << " for reading.");
+      return 0;
+    }
+    return readBool(inFile.begin(),inFile.end(),nbrVars);
+  }
+
+
+
+  /// Reads a bool array in the text format of writeBool() piece by
+  /// piece from a stream, e.g. stdin. Comment lines in front of the
+  /// data are skipped, the data is the first other line. Its '0' and
+  /// '1' are the bits, blanks and commas in between are ignored.
+  class boolReader{
+
+  protected:
+    istream& in;
+    vector<char> buffer;
+    size_t pos;
+    size_t filled;
+    /// inside the data line
+    bool inData;
+    /// the data line is finished
+    bool done;
+    bool failed;
+
+    /// next character or EOF
+    int get(){
+      if(pos==filled){
+        in.read(buffer.data(),buffer.size());
+        filled=in.gcount();
+        pos=0;
+        if(filled==0){
+          return EOF;
+        }
+      }
+      return buffer[pos++];
+    }
+
+    void skipLine(){
+      int c;
+      while((c=get())!=EOF && c!='\n'){}
+    }
+
+  public:
+
+    boolReader(istream& _in):in(_in),buffer(1<<16),pos(0),filled(0),inData(false),done(false),failed(false){}
+
+    /// Reads up to max bits into out. Returns the number of bits
+    /// read, less than max only at the end of the data (or on errors).
+    size_t read(bool* out, size_t max){
+      size_t re=0;
+      while(re<max && !done){
+        int c=get();
+        if(c==EOF){
+          done=true;
+        }else if(!inData){
+          if(c=='c' || c=='#'){
+            skipLine();
+          }else if(c!='\n'){
+            inData=true;
+            pos--;
+          }
+        }else if(c=='0' || c=='1'){
+          out[re++] = (c=='1');
+        }else if(c=='\n'){
+          done=true;
+        }else if(c!=' ' && c!=',' && c!='\t' && c!='\r'){
+          LOG_ERROR("unrecognized character '" << (char)c << "' in bool array.");
+          failed=true;
+          done=true;
+        }
+      }
+      return re;
+    }
+
+    /// false if the input was malformed
+    bool good() const{return !failed;}
+
+  };
+
+
 
   bool writeBool(ostream& outFile, const bool*const B, const size_t& nbrVars){
     outFile << "c This was written by the functionParser of KryptoSAT."<<endl;
@@ -135,7 +303,7 @@ namespace functionParser{
     ofstream outFile(file);
 
     if (!outFile.good()){
-      cerr<< "ERR: could not open file " << file << " for writing." <<endl;
+      LOG_ERROR("could not open file " << file << " for writing.");
       return false;
     }
     bool re = writeBool(outFile, B, nbrVars);
@@ -148,205 +316,334 @@ namespace functionParser{
 
 
 
-  booleanFct<BFT_AND>* readCNF(istream& cnfFile){
+  /// Reads a DIMACS CNF from the buffer [begin,end). Returns 0 on
+  /// format errors.
+  flatCNF* readCNF(const char* begin, const char* end){
 
     size_t nbrVars=0;
     size_t nbrClauses=0;
 
     size_t actualNbrClauses=0;
 
-    booleanFct<BFT_AND>* re=0;
-    string line;
-
-    while ( cnfFile.good() ){
-      getline(cnfFile,line);
-      //ignore empty/comment lines
-      if( line.size()>0 && line.at(0)!='c' && line.at(0)!='#' ){
-	istringstream iss(line);
-	string token;
-
-        /// first non comment lines specifies nbr of variables and clauses in the format
-        /// "p cnf nbrVars nbrClauses"
-        if(nbrVars==0){
-	  getline(iss, token, ' ');
-          if (token!="p"){
-            cerr<< "ERR: unrecognized file format. 'p' missing." <<endl;
-            return 0;
-          }
-	  getline(iss, token, ' ');
-          if (token!="cnf"){
-            cerr<< "ERR: unrecognized file format. 'cnf' missing." <<endl;
-            return 0;
-          }
-	  getline(iss, token, ' ');
-          nbrVars = stol(token);
-	  getline(iss, token, ' ');
-          nbrClauses = stol(token);
+    flatCNF* re=0;
+    dimacsScanner in(begin,end);
+    const char *line, *lineEnd;
+    vector<int> clause;
 
-          re = new booleanFct<BFT_AND>(nbrVars);
+    while ( in.nextLine(line,lineEnd) ){
+      const char* p=line;
 
-          /// all following lines define clauses in the format
-          /// [-]varNbr ... [-]varNbr 0
-          /// where - indocates NOT
-        }else{
-          bool finishedClause=false;
-          booleanFct<BFT_OR>* bigOr = new booleanFct<BFT_OR>(nbrVars);
-          while(getline(iss, token, ' ')){
-            if(finishedClause){
-              cerr<< "ERR: unrecognized file format. '0' has to indicate end of line." <<endl;
-              return 0;
-            }
-            long VN = stol(token);
-            if (VN<0){
-              VN = -VN;
-              bigOr->push_back(new booleanFct<BFT_NOT>(nbrVars,new booleanFct<BFT_INPUT>(nbrVars,VN-1)));
-            }else if (VN>0){
-              bigOr->push_back(new booleanFct<BFT_INPUT>(nbrVars,VN-1));
-            }else{
-              finishedClause=true;
-            }
+      /// first non comment lines specifies nbr of variables and clauses in the format
+      /// "p cnf nbrVars nbrClauses"
+      if(re==0){
+        if (!dimacsScanner::nextTokenIs(p,lineEnd,"p")){
+          LOG_ERROR("unrecognized file format. 'p' missing.");
+          return 0;
+        }
+        if (!dimacsScanner::nextTokenIs(p,lineEnd,"cnf")){
+          LOG_ERROR("unrecognized file format. 'cnf' missing.");
+          return 0;
+        }
+        if(!dimacsScanner::readSize(p,lineEnd,nbrVars) || !dimacsScanner::readSize(p,lineEnd,nbrClauses)){
+          LOG_ERROR("unrecognized file format. Expected 'p cnf nbrVars nbrClauses'.");
+          return 0;
+        }
+
+        re = new flatCNF(nbrVars);
+        re->reserve(nbrClauses,3*nbrClauses);
+
+        /// all following lines define clauses in the format
+        /// [-]varNbr ... [-]varNbr 0
+        /// where - indocates NOT
+      }else{
+        bool finishedClause=false;
+        clause.clear();
+        long VN;
+        while(!dimacsScanner::atEnd(p,lineEnd)){
+          if(finishedClause){
+            LOG_ERROR("unrecognized file format. '0' has to indicate end of line.");
+            delete re;
+            return 0;
           }
-          if(!finishedClause){
-            cerr<< "ERR: unrecognized file format. end of clause has to be indicated with '0'." <<endl;
+          if(!dimacsScanner::readInt(p,lineEnd,VN) || VN<INT_MIN || VN>INT_MAX){
+            LOG_ERROR("unrecognized file format. Literal expected.");
+            delete re;
             return 0;
           }
-
-          re->push_back(bigOr);
-          actualNbrClauses++;
+          if (VN!=0){
+            clause.push_back(VN);
+          }else{
+            finishedClause=true;
+          }
+        }
+        if(!finishedClause){
+          LOG_ERROR("unrecognized file format. end of clause has to be indicated with '0'.");
+          delete re;
+          return 0;
         }
+
+        re->addClause(clause.data(),clause.data()+clause.size());
+        actualNbrClauses++;
       }
     }
 
     if(actualNbrClauses != nbrClauses){
-      cerr<< "ERR: unrecognized file format. Specified number of clauses does not match given number of clauses." <<endl;
+      LOG_ERROR("unrecognized file format. Specified number of clauses does not match given number of clauses.");
+      delete re;
       return 0;
     }
 
+    //canonical clause order, cf. BF::recursiveSort()
+    if(re!=0){
+      re->sort();
+    }
+
     return re;
   }//end readCNF
 
 
-  booleanFct<BFT_AND>* readCNF(const char * file){
+  /// Public key from the binary format [begin,end), 0 on errors. The
+  /// clauses are stored in canonical order, hence the literals are
+  /// taken over as they are.
+  flatCNF* readBinaryCNF(const char* begin, const char* end){
+    binaryKeyHeader header;
+    size_t dataSize;
+    if(!readBinaryKeyHeader(begin,end,header,dataSize)){
+      return 0;
+    }
+    size_t nbrLiterals=dataSize/sizeof(int);
+    //clauses without literals would take no data, hence their number could not be checked
+    if(dataSize%sizeof(int)!=0
+       || (header.clauseSize==0 ? nbrLiterals!=0 || header.nbrClauses!=0 : header.nbrClauses != nbrLiterals/header.clauseSize || nbrLiterals%header.clauseSize!=0)){
+      LOG_ERROR("Binary key has the wrong size.");
+      return 0;
+    }
+    //the data is 8 byte aligned in the mapping
+    const int* literals=(const int*)(begin+sizeof(header));
+    for(size_t i=0;i<nbrLiterals;i++){
+      //in long long, as abs(INT_MIN) overflows
+      long long v=literals[i];
+      if(v==0 || (unsigned long long)(v<0 ? -v : v)>header.nbrVars){
+        LOG_ERROR("variable " << literals[i] << " does not exist!");
+        return 0;
+      }
+    }
+    flatCNF* re = new flatCNF(header.nbrVars);
+    re->reserve(header.nbrClauses,nbrLiterals);
+    re->addClauses(literals,header.nbrClauses,header.clauseSize);
+    return re;
+  }
+
+
+  /// The binary public key format stores clauses of fixed length only.
+  bool writeBinaryCNF(ostream& cnfFile, const flatCNF*const cnf){
+    size_t clauseSize;
+    if(!cnf->isUniform(clauseSize)){
+      LOG_ERROR("The binary format needs clauses of equal length.");
+      return false;
+    }
+    if(!writeBinaryKeyHeader(cnfFile,BINARYPUBLICKEYMAGIC,clauseSize,cnf->getNumberOfVars(),cnf->size())){
+      return false;
+    }
+    const int* literals = cnf->size()>0 ? cnf->clauseBegin(0) : 0;
+    cnfFile.write((const char*)literals,cnf->getNumberOfLiterals()*sizeof(int));
+    return cnfFile.good();
+  }
+
 
-    ifstream cnfFile(file);
-    if (!cnfFile.is_open()){
-      cerr<< "ERR: could not open file" << file << " for reading." <<endl;
+  /// Reads a CNF in the DIMACS or the binary public key format
+  /// (detected by its magic) from the buffer [begin,end). Returns 0 on
+  /// format errors.
+  flatCNF* readAnyCNF(const char* begin, const char* end){
+    if(isBinaryKey(begin,end,BINARYPUBLICKEYMAGIC)){
+      return readBinaryCNF(begin,end);
+    }
+    return readCNF(begin,end);
+  }
+
+
+  flatCNF* readCNF(istream& cnfFile){
+    string content((istreambuf_iterator<char>(cnfFile)),istreambuf_iterator<char>());
+    return readCNF(content.data(),content.data()+content.size());
+  }
+
+
+  flatCNF* readCNF(const char * file){
+
+    mappedFile cnfFile;
+    if (!cnfFile.open(file)){
+      LOG_ERROR("could not open file" << file << " for reading.");
       return 0;
     }
 
-    booleanFct<BFT_AND>* re = readCNF(cnfFile);
+    return readAnyCNF(cnfFile.begin(),cnfFile.end());
+  }
 
-    cnfFile.close();
-    return re;
+
+
+  /// Parses the line [line,end) 'p anf nbrVars nbrSummands' starting an ANF.
+  bool readANFHeader(const char* line, const char* end, size_t& nbrVars, size_t& nbrSummands){
+    if (!dimacsScanner::nextTokenIs(line,end,"p")){
+      LOG_ERROR("unrecognized file format. 'p' missing.");
+      return false;
+    }
+    if (!dimacsScanner::nextTokenIs(line,end,"anf")){
+      LOG_ERROR("unrecognized file format. 'anf' missing.");
+      return false;
+    }
+    if(!dimacsScanner::readSize(line,end,nbrVars) || !dimacsScanner::readSize(line,end,nbrSummands)){
+      LOG_ERROR("unrecognized file format. Expected 'p anf nbrVars nbrSummands'.");
+      return false;
+    }
+    return true;
   }
 
 
+  /// Parses one summand line [line,end) '[varNbr ...] 0' into
+  /// summand. An empty summand is the constant 1.
+  bool readSummand(const char* line, const char* end, vector<unsigned int>& summand, const size_t& nbrVars){
+    bool finishedClause=false;
+    summand.clear();
+    long VN;
 
-  booleanFct<BFT_XOR>* readANF(istream& anfFile){
+    while(!dimacsScanner::atEnd(line,end)){
+      if(!dimacsScanner::readInt(line,end,VN)){
+        LOG_ERROR("unrecognized file format. Variable number expected.");
+        return false;
+      }
+      if(finishedClause && VN!=0){
+        LOG_ERROR("unrecognized file format. '0' has to indicate end of line. (Multiple '0's allowed.)");
+        return false;
+      }
+      if (VN<0){
+        LOG_ERROR("unrecognized file format. ANF must not contain negations");
+        return false;
+      }else if ((size_t)VN>nbrVars){
+        LOG_ERROR("variable " << VN << " does not exist!");
+        return false;
+      }else if (VN>0){
+        summand.push_back(VN);
+      }else{
+        finishedClause=true;
+      }
+    }
+    if(!finishedClause){
+      LOG_ERROR("unrecognized file format. End of summand has to be indicated with '0'.");
+      return false;
+    }
+    return true;
+  }
 
-    size_t nbrVars=0;
+
+  /// Reads one ANF ('p anf nbrVars nbrSummands' followed by the
+  /// summands) into re. Stops in front of the next 'p' line, hence
+  /// several ANFs can be read from one scanner. Returns false on
+  /// format errors.
+  bool readANF(dimacsScanner& in, flatANF& re, size_t& nbrVars){
+
+    nbrVars=0;
     size_t nbrClauses=0;
 
     size_t actualNbrClauses=0;
 
-    booleanFct<BFT_XOR>* re=0;
-    string line;
-
-    while ( anfFile.good() ){
-      getline(anfFile,line);
-      //ignore empty/comment lines
-      if( line.size()>0 && line.at(0)!='c' && line.at(0)!='#' ){
-	istringstream iss(line);
-	string token;
-
-        /// first non comment lines specifies nbr of variables and clauses in the format
-        /// "p cnf nbrVars nbrClauses"
-        if(nbrVars==0){
-	  getline(iss, token, ' ');
-          if (token != "p"){
-            cerr<< "ERR: unrecognized file format. 'p' missing." <<endl;
-            return 0;
-          }
-	  getline(iss, token, ' ');
-          if (token!="anf"){
-            cerr<< "ERR: unrecognized file format. 'anf' missing." <<endl;
-            return 0;
-          }
-	  getline(iss, token, ' ');
-          nbrVars = stol(token);
-	  getline(iss, token, ' ');
-          nbrClauses = stol(token);
+    re.clear();
+    const char *line, *lineEnd;
+    vector<unsigned int> summand;
 
-	  cout << "Reading " << nbrClauses << " clauses with " << nbrVars << " variables"<<endl;
+    /// first non comment lines specifies nbr of variables and clauses in the format
+    /// "p anf nbrVars nbrClauses"
+    if(!in.nextLine(line,lineEnd)){
+      LOG_ERROR("No ANF specification found in file!");
+      return false;
+    }
+    if(!readANFHeader(line,lineEnd,nbrVars,nbrClauses)){
+      return false;
+    }
 
-          re = new booleanFct<BFT_XOR>(nbrVars);
+    LOG_DEBUG("Reading " << nbrClauses << " clauses with " << nbrVars << " variables");
 
-          /// all following lines define clauses in the format
-          /// [-]varNbr ... [-]varNbr 0
-          /// where - indocates NOT
-        }else{
-          bool finishedClause=false;
-          booleanFct<BFT_AND>* bigAnd = new booleanFct<BFT_AND>(nbrVars);
-
-          while(getline(iss, token, ' ')){
-            if(finishedClause && token!="0"){
-              cerr<< "ERR: unrecognized file format. '0' has to indicate end of line. (Multiple '0's allowed.)" <<endl;
-              return 0;
-            }
-            long VN = stol(token);
-            if (VN<0){
-              cerr<< "ERR: unrecognized file format. ANF must not contain negations" <<endl;
-              return 0;
-            }else if (VN>0){
-              bigAnd->push_back(new booleanFct<BFT_INPUT>(nbrVars,VN-1));
-            }else{
-              finishedClause=true;
-            }
-          }
-          if(!finishedClause){
-            cerr<< "ERR: unrecognized file format. End of summand has to be indicated with '0'." <<endl;
-            return 0;
-          }
-
-          //make sure that each and has at least one child
-          if (bigAnd->size()<1){
-            bigAnd->push_back(new booleanFct<BFT_TRUE>(nbrVars));
-          }
+    re.reserve(nbrClauses,4*nbrClauses);
 
-          re->push_back(bigAnd);
-	  // cout << "found clause: " << re->toString()<<endl;
-          actualNbrClauses++;
-        }
+    /// all following lines define summands in the format
+    /// varNbr ... varNbr 0
+    while(in.peekLine(line,lineEnd) && *line!='p'){
+      in.nextLine(line,lineEnd);
+      if(!readSummand(line,lineEnd,summand,nbrVars)){
+        return false;
       }
+      re.addMonomial(summand.data(),summand.data()+summand.size());
+      actualNbrClauses++;
     }
 
     if(actualNbrClauses != nbrClauses){
-      cerr<< "ERR: unrecognized file format. Specified number of summands does not match given number of summands." <<endl;
-      return 0;
+      LOG_ERROR("unrecognized file format. Specified number of summands does not match given number of summands.");
+      return false;
     }
 
-    if(re==0){
-      cerr << "ERR: No ANF specification found in file!"<<endl;
+    if(re.size()==0){
+      LOG_ERROR("No clauses found in file!");
+    }
+
+    return true;
+  }//end readANF
+
+
+  /// Reads the single ANF in anfFile into re. Returns false on format errors.
+  bool readANF(istream& anfFile, flatANF& re, size_t& nbrVars){
+    string content((istreambuf_iterator<char>(anfFile)),istreambuf_iterator<char>());
+    dimacsScanner in(content.data(),content.data()+content.size());
+    if(!readANF(in,re,nbrVars)){
+      return false;
     }
+    const char *line, *lineEnd;
+    if(in.nextLine(line,lineEnd)){
+      LOG_ERROR("unrecognized file format. More than one ANF in file.");
+      return false;
+    }
+    return true;
+  }
 
-    if(re->size()==0){
-      cerr << "ERR: No clauses found in file!"<<endl;
+
+  booleanFct<BFT_XOR>* toBooleanFct(const flatANF& anf, const size_t& nbrVars){
+    booleanFct<BFT_XOR>* re= new booleanFct<BFT_XOR>(nbrVars);
+
+    for(size_t i=0;i<anf.size();i++){
+      re->push_back(new booleanFct<BFT_AND>(nbrVars));
+      if(anf.monomialSize(i)==0){
+        re->back()->push_back(new booleanFct<BFT_TRUE>(nbrVars));
+      }
+      for(const unsigned int* j=anf.monomialBegin(i);j!=anf.monomialEnd(i);j++){
+        re->back()->push_back(new booleanFct<BFT_INPUT>(nbrVars,*j - 1));
+      }
     }
-    
     return re;
+  }
+
+
+  booleanFct<BFT_XOR>* readANF(istream& anfFile){
+    flatANF anf;
+    size_t nbrVars;
+    if(!readANF(anfFile,anf,nbrVars)){
+      return 0;
+    }
+    return toBooleanFct(anf,nbrVars);
   }//end readANF
 
 
   booleanFct<BFT_XOR>* readANF(const char * file){
-    ifstream anfFile(file);
+    mappedFile anfFile;
 
-    if (!anfFile.is_open()){
-      cerr<< "ERR: could not open file" << file << " for reading." <<endl;
+    if (!anfFile.open(file)){
+      LOG_ERROR("could not open file" << file << " for reading.");
       return 0;
     }
-    booleanFct<BFT_XOR>* re = readANF(anfFile);
-    anfFile.close();
-    return re;
+    dimacsScanner in(anfFile.begin(),anfFile.end());
+    flatANF anf;
+    size_t nbrVars;
+    if(!readANF(in,anf,nbrVars)){
+      return 0;
+    }
+    return toBooleanFct(anf,nbrVars);
   }
 
 
@@ -355,21 +652,16 @@ namespace functionParser{
 
 
   /// return indicates success
-  bool writeCNF(ostream& cnfFile, const booleanFct<BFT_AND>*const cnf){
+  bool writeCNF(ostream& cnfFile, const flatCNF*const cnf){
 
     cnfFile << "c This cnf file was written by the cnfparser of KryptoSAT."<<endl;
     cnfFile << "c The format is specified in e.g. http://www.dwheeler.com/essays/minisat-user-guide.html"<<endl<<"c"<<endl;
 
     cnfFile << "p cnf " << cnf->getNumberOfVars() << " " << cnf->size()<<endl;
 
-    for(list<BF*>::const_iterator it = cnf->begin();it != cnf->end();it++){
-      if((*it)->myType() != BFT_OR){
-        cerr << "ERR: Function is not in CNF!"<<endl;
-        return false;
-      }
-
-      for(list<BF*>::const_iterator j = (*it)->begin();j != (*it)->end();j++){
-        cnfFile << (*j)->getDependence() << " ";
+    for(size_t i=0;i<cnf->size();i++){
+      for(const int* l=cnf->clauseBegin(i);l!=cnf->clauseEnd(i);l++){
+        cnfFile << *l << " ";
       }
       cnfFile << "0"<<endl;
     }
@@ -378,11 +670,11 @@ namespace functionParser{
 
   }//end writeCNF
 
-  bool writeCNF(const char * file, const booleanFct<BFT_AND>*const cnf){
+  bool writeCNF(const char * file, const flatCNF*const cnf){
     ofstream cnfFile(file);
 
     if (!cnfFile.good()){
-      cerr<< "ERR: could not open file " << file << " for writing." <<endl;
+      LOG_ERROR("could not open file " << file << " for writing.");
       return false;
     }
     bool re = writeCNF(cnfFile, cnf);
@@ -406,7 +698,7 @@ namespace functionParser{
 
     for(list<BF*>::const_iterator i = anf->begin();i != anf->end();i++){
       if((*i)->myType() != BFT_AND){
-        cerr << "ERR: Function is not in ANF!"<<endl;
+        LOG_ERROR("Function is not in ANF!");
         return false;
       }
 
@@ -425,7 +717,7 @@ namespace functionParser{
     ofstream anfFile(file);
 
     if (!anfFile.good()){
-      cerr<< "ERR: could not open file " << file << " for writing." <<endl;
+      LOG_ERROR("could not open file " << file << " for writing.");
       return false;
     }
 
@@ -435,6 +727,210 @@ namespace functionParser{
   }
 
 
+  /// return indicates success
+  bool writeANF(ostream& anfFile, const flatANF& anf, const size_t& nbrVars){
+
+    anfFile << "c The format of the next line is 'p anf numberOfVariables NumberOfSummands'"<<endl;
+    anfFile << "p anf " << nbrVars << " " << anf.size()<<endl;
+
+    anfFile<<"c The following lines specify the summands, one per line."<<endl;
+    anfFile<<"c Each summand is a conjunction of variables (without negation)."<<endl;
+    anfFile << "c These are given as a space seperated list of their indices terminated by '0'."<<endl;
+    anfFile << "c A double  '0 0' indicates the constant summand '1'."<<endl;
+
+    for(size_t i=0;i<anf.size();i++){
+      if(anf.monomialSize(i)==0){
+        anfFile << "0 ";
+      }
+      for(const unsigned int* j=anf.monomialBegin(i);j!=anf.monomialEnd(i);j++){
+        anfFile << *j << " ";
+      }
+      anfFile << "0\n";
+    }
+
+    return anfFile.good();
+
+  }//end writeANF
+
+
+
+  /// appends x as LEB128 varint, i.e. 7 bits per byte, low bits
+  /// first, the high bit set on all but the last byte
+  void writeVarint(string& out, unsigned long long x){
+    while(x>=0x80){
+      out.push_back((char)(x|0x80));
+      x>>=7;
+    }
+    out.push_back((char)x);
+  }
+
+  /// appends x as varint of exactly bytes bytes (padded with empty
+  /// continuation bytes), such that it can be overwritten in place
+  void writePaddedVarint(string& out, unsigned long long x, unsigned int bytes){
+    for(unsigned int i=0;i+1<bytes;i++){
+      out.push_back((char)((x&0x7f)|0x80));
+      x>>=7;
+    }
+    out.push_back((char)x);
+  }
+
+  /// reads a varint from [p,end), false if truncated or too long
+  bool readVarint(const char*& p, const char* end, unsigned long long& x){
+    x=0;
+    for(unsigned int shift=0;p<end && shift<64;shift+=7){
+      unsigned char b=*p++;
+      //the 10th byte holds only the top bit
+      if(shift==63 && b>1){
+        return false;
+      }
+      x |= (unsigned long long)(b&0x7f) << shift;
+      if(b<0x80){
+        return true;
+      }
+    }
+    return false;
+  }
+
+
+  /// Binary ANF encoding, appended to out:
+  /// varint nbrVars, varint nbrSummands, then per summand
+  /// varint (number of leading variables shared with the previous
+  /// summand), varint (number of further variables) and these further
+  /// variables as varint differences to their predecessor (the last
+  /// shared variable, 0 if none). The variables of every summand have
+  /// to be strictly ascending, consecutive sorted summands share long
+  /// prefixes. The constant 1 is the empty summand.
+  bool writeBinaryANF(string& out, const flatANF& anf, const size_t& nbrVars){
+    writeVarint(out,nbrVars);
+    writeVarint(out,anf.size());
+    const unsigned int* prev=0;
+    size_t prevSize=0;
+    for(size_t i=0;i<anf.size();i++){
+      const unsigned int* v=anf.monomialBegin(i);
+      size_t size=anf.monomialSize(i);
+      size_t shared=0;
+      while(shared<size && shared<prevSize && v[shared]==prev[shared]){
+        shared++;
+      }
+      writeVarint(out,shared);
+      writeVarint(out,size-shared);
+      unsigned int last = shared>0 ? v[shared-1] : 0;
+      for(size_t j=shared;j<size;j++){
+        if(v[j]<=last){
+          LOG_ERROR("summand variables are not strictly ascending.");
+          return false;
+        }
+        writeVarint(out,v[j]-last);
+        last=v[j];
+      }
+      prev=v;
+      prevSize=size;
+    }
+    return true;
+  }
+
+
+  /// Decodes one ANF written by writeBinaryANF() summand by summand,
+  /// without holding more than the current summand.
+  class binaryANFReader{
+
+  protected:
+    const char* p;
+    const char* end;
+    size_t nbrVars;
+    size_t nbrSummands;
+    size_t readSummands;
+
+  public:
+
+    binaryANFReader():p(0),end(0),nbrVars(0),nbrSummands(0),readSummands(0){}
+
+    /// reads the ANF header at p, false on format errors
+    bool begin(const char* _p, const char* _end){
+      p=_p;
+      end=_end;
+      unsigned long long vars, summands;
+      if(!readVarint(p,end,vars) || !readVarint(p,end,summands)){
+        LOG_ERROR("unrecognized file format. Truncated binary ANF.");
+        return false;
+      }
+      //variables are stored as unsigned int
+      if(vars>UINT_MAX){
+        LOG_ERROR("unrecognized file format. Too many variables in binary ANF.");
+        return false;
+      }
+      nbrVars=vars;
+      nbrSummands=summands;
+      readSummands=0;
+      return true;
+    }
+
+    size_t getNumberOfVars() const{return nbrVars;}
+    size_t getNumberOfSummands() const{return nbrSummands;}
+
+    /// true while not all summands are read
+    bool hasNext() const{return readSummands<nbrSummands;}
+
+    /// decodes the next summand into summand, which has to hold the
+    /// previous one
+    bool next(vector<unsigned int>& summand){
+      unsigned long long shared, further, delta;
+      if(!readVarint(p,end,shared) || !readVarint(p,end,further)){
+        LOG_ERROR("unrecognized file format. Truncated binary ANF.");
+        return false;
+      }
+      if(shared>summand.size() || further>nbrVars){
+        LOG_ERROR("unrecognized file format. Invalid binary summand.");
+        return false;
+      }
+      summand.resize(shared);
+      unsigned long long last = shared>0 ? summand.back() : 0;
+      for(size_t j=0;j<further;j++){
+        if(!readVarint(p,end,delta)){
+          LOG_ERROR("unrecognized file format. Truncated binary ANF.");
+          return false;
+        }
+        //checked before adding, the sum could wrap around
+        if(delta==0 || delta>nbrVars-last){
+          LOG_ERROR("variable " << last << "+" << delta << " does not exist!");
+          return false;
+        }
+        last+=delta;
+        summand.push_back(last);
+      }
+      readSummands++;
+      return true;
+    }
+
+    /// the position behind the ANF, once all summands are read
+    const char* position() const{return p;}
+
+  };
+
+
+  /// Reads one ANF written by writeBinaryANF() from [p,end) into re
+  /// and advances p behind it. Returns false on format errors.
+  bool readBinaryANF(const char*& p, const char* end, flatANF& re, size_t& nbrVars){
+    binaryANFReader in;
+    if(!in.begin(p,end)){
+      return false;
+    }
+    nbrVars=in.getNumberOfVars();
+    re.clear();
+    //every summand takes at least two bytes, do not trust the count beyond that
+    size_t summands = in.getNumberOfSummands() < (size_t)(end-p)/2 ? in.getNumberOfSummands() : (end-p)/2;
+    re.reserve(summands,4*summands);
+    vector<unsigned int> summand;
+    while(in.hasNext()){
+      if(!in.next(summand)){
+        return false;
+      }
+      re.addMonomial(summand.data(),summand.data()+summand.size());
+    }
+    p=in.position();
+    return true;
+  }
+
 
 
 
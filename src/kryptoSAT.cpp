@@ -42,9 +42,15 @@
 
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <string>
 
 #include <stdexcept>
+#include <fstream>
+#include <algorithm>
+
+#include <sys/stat.h>
+#include <dirent.h>
 
 using namespace std;
 
@@ -54,6 +60,7 @@ using namespace functionParser;
 #include "booleanFct.h"
 #include "rng.h"
 #include "kryptoSAT.h"
+#include "batch.h"
 
 using namespace kryptoSAT;
 
@@ -65,36 +72,63 @@ public:
   bool generateMode;
   bool encryptMode;
   bool decryptMode;
+  bool streamMode;
+  /// write keys and ciphers in the binary formats
+  bool binaryFormat;
+  /// "pub", "priv" or "cipher" if the file convertFile is to be converted
+  string convertType;
+  string convertFile;
+  /// manifest or directory of clear texts to encrypt in one go
+  string batchFile;
 
   string pubFile;
   string privFile;
   string clearFile;
   string cipherFile;
   string outFile;
+  /// dump the metrics of the run here, if not empty
+  string metricsFile;
+  /// number of -v given, each lowers the log level by one
+  unsigned int verbosity;
 
   unsigned int k;
   size_t n;
   size_t m;
 
-  booleanFct<BFT_AND>* publicKey;
+  flatCNF* publicKey;
   bool* privateKey;
 
   bool* clearText;
   size_t clearTextLength;
-  booleanFct<BFT_XOR>** cipher;
+  flatANF* cipher;
+  /// number of variables the cipher refers to
+  size_t cipherVars;
 
 
   size_t salt;
+  /// salt given by -s, otherwise every text of a batch gets its own
+  bool saltGiven;
   rng * r;
 
   //  size_t alpha;
   size_t beta;
 
+  unsigned int encoderVersion;
+  bool encoderVersionGiven;
+  unsigned int threads;
+
+  /// seed of the key generation, drawn at random unless given
+  size_t keySeed;
+  bool keySeedGiven;
+
   state():
     batchMode(false),
     generateMode(false),
     encryptMode(false),
     decryptMode(false),
+    streamMode(false),
+    binaryFormat(false),
+    verbosity(0),
     k(3),
     n(1024),
     m(0),
@@ -103,27 +137,34 @@ public:
     clearText(0),
     clearTextLength(0),
     cipher(0),
+    cipherVars(0),
+    saltGiven(false),
     //    alpha(0),
-    beta(3)
+    beta(3),
+    encoderVersion(ENCODERVERSION),
+    encoderVersionGiven(false),
+    threads(thread::hardware_concurrency()),
+    keySeed(0),
+    keySeedGiven(false)
   {
+    if(threads<1){
+      threads=1;
+    }
     r=new mersenneTwisterRNG();
     salt=r->getGoodSeed();
   }
 
+  /// also writes the metrics, as every way out of main() passes here
   ~state(){
+    if(metricsFile!=""){
+      metrics().save(metricsFile);
+    }
     delete publicKey;
     publicKey=0;
-    delete privateKey;
+    delete[] privateKey;
     privateKey=0;
-    delete clearText;
+    delete[] clearText;
     clearText=0;
-    if(cipher!=0){
-      for(unsigned int i=0;i<clearTextLength;i++){
-	cipher[i]->disposeChildren();
-	delete cipher[i];
-	cipher[i]=0;
-      }
-    }
     delete[] cipher;
     cipher=0;
     delete r;//=>crash??
@@ -131,22 +172,22 @@ public:
 
   bool conflict(){
     if(batchMode && outFile.compare("")==0){
-      cerr << "Conflict: Trying to enter batch mode without output file."<<endl;
+      LOG_ERROR("Conflict: Trying to enter batch mode without output file.");
       return true;
     }
 
     if (generateMode && decryptMode){
-      cerr << "Conflict: Generating a random key to decrypt a given cipher does not make sense."<<endl;
+      LOG_ERROR("Conflict: Generating a random key to decrypt a given cipher does not make sense.");
       return true;
     }
 
     if(encryptMode && (clearFile.compare("")==0 || (pubFile=="" && ! generateMode))){
-      cerr << "Conflict: I can not encrypt without a public key and clear text."<<endl;
+      LOG_ERROR("Conflict: I can not encrypt without a public key and clear text.");
       return true;
     }
 
     if(decryptMode && (cipherFile.compare("")==0 || (privFile=="" && ! generateMode))){
-      cerr << "Conflict: I can not decrypt without a private key and cipher."<<endl;
+      LOG_ERROR("Conflict: I can not decrypt without a private key and cipher.");
       return true;
     }
 
@@ -159,25 +200,50 @@ public:
     }
   }
 
+  cipherHeader getCipherHeader() const{
+    cipherHeader re;
+    re.salt=salt;
+    re.textLength=clearTextLength;
+    re.beta=beta;
+    re.encoderVersion=encoderVersion;
+    return re;
+  }
+
+  void setCipherHeader(const cipherHeader& header){
+    salt=header.salt;
+    clearTextLength=header.textLength;
+    beta=header.beta;
+    encoderVersion=header.encoderVersion;
+  }
+
 };
 
 
 void help(){
-  cout << "kryptoSAT [-h] [-b] [-g [-ksat LITERALSPERCLAUSE=3] [-n VARIABLES=1024] [-m CLAUSES=5n]] [-k PUBLICKEYFILE]  [-K PRIVATEKEYFILE] [-be BETA=3] [-c CIPHERFILE] [-t CLEARTEXTFILE] [-s SALT] [-o OUTFILE]"<<endl;
+  cout << "kryptoSAT [-h] [-b] [-g [-ksat LITERALSPERCLAUSE=3] [-n VARIABLES=1024] [-m CLAUSES=5n] [-ks KEYSEED]] [-k PUBLICKEYFILE]  [-K PRIVATEKEYFILE] [-be BETA=3] [-ev VERSION] [-j THREADS] [-c CIPHERFILE] [-t CLEARTEXTFILE] [-stream] [-f text|bin] [-s SALT] [-o OUTFILE] [-convert pub|priv|cipher FILE -o OUTFILE] [-batch MANIFEST|DIRECTORY] [--metrics FILE] [-v]"<<endl;
   cout << "-h\tDisplay this help."<<endl;
   cout << "-b\tBatchmode enforced. If conflicts are encountered, exit with an error instead of entering interactive mode. Must be used with -o."<<endl;
   cout << "-g\tGenerate new key pair. Conflicts with -k and -K."<<endl;
   cout << "\t-ksat\twith ksat=LITERALSPERCLAUSE literals per clause. Implies -g."<<endl;
   cout << "\t-n\twith n=VARIABLES private key size. Implies -g."<<endl;
   cout << "\t-m\twith m=CLAUSES clauses. Implies -g. "<<endl;
+  cout << "\t-ks\tDerive the key pair from KEYSEED, the same seed gives the same keys for any number of threads. Implies -g. Keep KEYSEED as secret as the private key."<<endl;
   cout << "-k\tRead public key from PUBLICKEYFILE. Conflicts with -g."<<endl;
   cout << "-K\tRead private key from PRIVATEKEYFILE. Conflicts with -g."<<endl;
   //  cout << "-al\tSet alpha=ALPHA parameter for encryption. CAUTION 2<alpha<8 recommended." <<endl;
   cout << "-be\tSet beta=BETA parameter for encryption." <<endl;
+  cout << "-ev\tEncrypt with encoder version VERSION (default " << ENCODERVERSION << "). Version " << LEGACYENCODERVERSION << " can not use more than one thread, version 3 only one per bit. Version " << STREAMINGENCODERVERSION << " is only used by -stream." <<endl;
+  cout << "-j\tUse THREADS threads (default: number of cores)." <<endl;
 
   cout << "-c\tRead cipher from CIPHERFILE and decrypt with private key, if given."<<endl;
   cout << "-t\tRead clear text from CLEARTEXTFILE and encrypt with public key, if given."<<endl;
+  cout << "-stream\tEncrypt/decrypt while reading the clear text/cipher and write out every bit right away, without holding the whole text or cipher. CLEARTEXTFILE may be - (stdin). Encryption uses encoder version " << STREAMINGENCODERVERSION << ", seeded with a random secret per message that is not stored: such ciphers can not be verified by encrypting again." <<endl;
   cout << "-s\tSet the salt for encryption to SALT."<<endl;
+  cout << "-f\tWrite keys and ciphers in the text (default) or the binary format. Either is detected when reading."<<endl;
+  cout << "-convert\tRead the public key, private key or cipher FILE and write it to OUTFILE in the format chosen by -f."<<endl;
+  cout << "-batch\tEncrypt many clear texts with the public key -k, preparing the key once and sharing the threads among all bits. MANIFEST has one line CLEARTEXTFILE OUTFILE per text, the cipher is written to OUTFILE.cipher. For a DIRECTORY every file in it is encrypted to OUTFILE/NAME.cipher. The ciphers are the same as by -t with the same salt, without -s every text gets its own random salt. Needs encoder version 3 or above, but not " << STREAMINGENCODERVERSION << "."<<endl;
+  cout << "--metrics\tWrite wall and CPU time per phase, per bit latency histograms, monomial counts and peak cipher sizes of the run as JSON to FILE."<<endl;
+  cout << "-v\tMore verbose output, repeat for debug messages of the encryption engine. Batch mode only reports warnings and errors without it."<<endl;
   cout << "-o\tTry to do something useful with the other options given and write the output to OUTFILE. If this option is omitted or conflicting options are given, kryptoSAT will enter an interactive mode, unless -b is specified."<<endl;
   cout <<endl;
   exit(0);
@@ -186,33 +252,40 @@ void help(){
 /// verify pub(priv)=1
 bool checkKeyPair(state& I){
   if(I.publicKey==0||I.privateKey==0){
-    cerr << "ERR: No key pair loaded."<<endl;
+    LOG_ERROR("No key pair loaded.");
     return false;
   }
 
   bool re = I.publicKey->evaluate(I.privateKey);
   if(!re){
-    cerr<<"Invalid key pair!"<<endl;
+    LOG_ERROR("Invalid key pair!");
   }else{
-    cout << "\n\t[OK]\tpub(priv)=1. Key pair valid."<<endl;
+    LOG_INFO("\n\t[OK]\tpub(priv)=1. Key pair valid.");
   }
   return re;
 }
 
 
 bool generateKeyPair(state& I){
-  cout << "Generating new key pair..."<<endl;
-  I.r->randomise(I.r->getGoodSeed());
-  I.privateKey = generatePrivateKey(I.r,I.n);
-  cout << "Private key generated"<<endl;
+  phaseTimer timer("keygen");
+  LOG_INFO("Generating new key pair with " << I.threads << " threads...");
+  if(!I.keySeedGiven){
+    //the key seed determines the private key, it is not shown
+    I.keySeed = I.r->getGoodSeed() ^ ((size_t)I.r->getGoodSeed() << 32);
+  }
+  delete[] I.privateKey;
+  I.privateKey = generatePrivateKey(I.r,I.keySeed,I.n);
+  LOG_INFO("Private key generated");
   //  writeBool(cout, I.privateKey, I.n);
-  I.publicKey = generatePublicKey(I.r, I.privateKey,I.n,I.m, I.k);
-  cout << "Public key generated"<<endl;
+  delete I.publicKey;
+  I.publicKey = generatePublicKey(I.r, I.keySeed, I.privateKey,I.n,I.m, I.k, I.threads);
+  LOG_INFO("Public key generated");
   //writeCNF(cout, I.publicKey);
   return (I.publicKey !=0 && I.privateKey !=0);
 }
 
 bool readPublicKey(state& I){
+  phaseTimer timer("readPublicKey");
   if(!I.batchMode){
     string in;
     cout << "Public key file name (" << I.pubFile <<"):";
@@ -223,12 +296,16 @@ bool readPublicKey(state& I){
   }
 
   I.publicKey=readCNF(I.pubFile.c_str());
+  if(I.publicKey==0){
+    return false;
+  }
   I.n = I.publicKey->getNumberOfVars();
 
-  return I.publicKey!=0;
+  return true;
 }
 
 bool readPrivateKey(state& I){
+  phaseTimer timer("readPrivateKey");
   if(!I.batchMode){
     string in;
     cout << "Private key file name (" << I.privFile <<"):";
@@ -246,6 +323,7 @@ bool readPrivateKey(state& I){
 
 
 bool readText(state& I){
+  phaseTimer timer("readText");
   if(!I.batchMode){
     string in;
     cout << "Text file name (" << I.clearFile <<"):";
@@ -262,7 +340,19 @@ bool readText(state& I){
 
 
 
+/// prints how fast bytes were parsed since start
+void reportThroughput(size_t bytes, clock_t start){
+  double seconds = (double)(clock()-start)/CLOCKS_PER_SEC;
+  double mb = bytes/1e6;
+  if(seconds>0){
+    LOG_INFO("Parsed " << mb << " MB in " << seconds << " s (" << mb/seconds << " MB/s)");
+  }else{
+    LOG_INFO("Parsed " << mb << " MB in " << seconds << " s");
+  }
+}
+
 bool readCipher(state& I){
+  phaseTimer timer("readCipher");
 
   if(!I.batchMode){
     string in;
@@ -273,134 +363,289 @@ bool readCipher(state& I){
     }
   }
 
-  ifstream file(I.cipherFile);
+  mappedFile file;
+  if (!file.open(I.cipherFile.c_str())){
+    LOG_ERROR("could not open file " << I.cipherFile << " for reading.");
+    return false;
+  }
 
-  cout << "Reading cipher from " << I.cipherFile<<endl;
+  LOG_INFO("Reading cipher from " << I.cipherFile);
+  clock_t start=clock();
 
-  stringstream * temp = 0;
-  I.salt=0;
-  bool found=false;
-  for (string line; getline(file, line)&& !found;) {
-    if(line.size()>0){
-      if(line.at(0)=='s'){
-	istringstream iss(line);
-	string token;
-        found = getline(iss, token, ' ') && getline(iss, token, ' ');
-	I.salt = stol(token);
-        found = found && getline(iss, token, ' ');
-        I.clearTextLength = stol(token);
-        found = found && getline(iss, token, ' ');
-	I.beta = stol(token);
-        continue;
-      }
-    }
+  cipherHeader header;
+  bool re=readCipher(file.begin(),file.end(),header,I.cipher,I.cipherVars);
+  I.setCipherHeader(header);
+  if(!re){
+    return false;
   }
+  reportThroughput(file.size(),start);
+  LOG_INFO("\n\t[OK]\tCipher read.");
+
+  return true;
+}
+
+
 
-  if(!found){
-    cerr <<"ERR: File format error."<<endl;
+bool encrypt(state& I){
+  phaseTimer timer("encrypt");
+  if(I.clearText==0){
+    LOG_ERROR("No clear text loaded!");
+    return false;
+  }
+  if(I.publicKey==0){
+    LOG_ERROR("No public key loaded!");
+    return false;
+  }
+  if(I.encoderVersion<LEGACYENCODERVERSION || I.encoderVersion>ENCODERVERSION){
+    LOG_ERROR("Unknown encoder version " << I.encoderVersion);
     return false;
   }
-  cout << "Reading cipher of length " << I.clearTextLength << " salt = " <<I.salt<<endl;
 
-  I.cipher = new booleanFct<BFT_XOR>*[I.clearTextLength];
-  size_t i=0;
+  delete[] I.cipher;
+  I.cipher = new flatANF[I.clearTextLength];
+  I.cipherVars = I.n;
+  //the public key is kept in canonical order since loading/generation
 
-  for (string line; getline(file, line); ) {
-    if(line.size()>0){
-      if(line.at(0)=='p'){
-        if(temp!=0){
-          I.cipher[i] = readANF(*temp);
-          delete temp;
-          if(I.cipher[i]==0){
-            cerr << "ERR: Error reading cipher."<<endl;
-            return false;
-          }
-          i++;
-        }
-        temp = new stringstream();
-      }
-      if(temp!=0){
-        *temp << line <<endl;
-      }
-    }
+  LOG_INFO("Salting clear text with " << I.salt);
+
+  preparedPublicKey key(I.publicKey, I.n);
+
+  if(!encryptText(I.r, key, I.clearText, I.clearTextLength, I.salt, I.beta, I.encoderVersion, I.threads, I.cipher)){
+    return false;
   }
-  file.close();
+  LOG_INFO("\n\t[OK]\tEncryption done");
 
-  //last anf
-  I.cipher[i] = readANF(*temp);
-  delete temp;
-  if(I.cipher[i]==0){
-    cerr << "ERR: Error reading cipher."<<endl;
+  return true;
+}
+
+bool decrypt(state& I){
+  phaseTimer timer("decrypt");
+  if(I.cipher==0){
+    LOG_ERROR("No cipher loaded!");
+    return false;
+  }
+  if(I.privateKey==0){
+    LOG_ERROR("No private key loaded!");
     return false;
   }
-  i++;
 
-  if(i != I.clearTextLength){
-    cout << "ERR: Read " << i << " encrypted bits, although text length should be " << I.clearTextLength <<endl;
+  if(I.cipherVars > I.n){
+    LOG_ERROR("The cipher refers to " << I.cipherVars << " variables, but the private key has only " << I.n);
     return false;
   }
 
-  cout << "\n\t[OK]\tCipher read."<<endl;
+  delete[] I.clearText;
+  I.clearText = new bool[I.clearTextLength];
+  LOG_INFO("Starting decryption...");
+
+  packedKey key(I.privateKey,I.n);
+  for(size_t i=0;i<I.clearTextLength;i++){
+    unsigned long long start=wallTime();
+    I.clearText[i]= evaluate(key,I.cipher[i]);
+    metrics().addSample("decryptBit",(wallTime()-start)/1e6);
+    metrics().count("decrypt.monomials",I.cipher[i].size());
+  }
+  LOG_INFO("done");
 
   return true;
 }
 
 
-
-bool encrypt(state& I){
-  if(I.clearText==0){
-    cerr <<"ERR: No clear text loaded!"<<endl;
+/// checks the end of an encrypted bit in decryptStream(), which was
+/// started at wall time bitStart, and appends it to bits
+bool finishStreamBit(state& I, vector<bool>& bits, streamEvaluator& bit, size_t nbrSummands, size_t readSummands, unsigned long long bitStart){
+  if(bits.size()>=I.clearTextLength){
+    LOG_ERROR("More encrypted bits than the text length " << I.clearTextLength);
     return false;
   }
-  if(I.publicKey==0){
-    cerr <<"ERR: No public key loaded!"<<endl;
+  if(readSummands!=nbrSummands){
+    LOG_ERROR("unrecognized file format. Specified number of summands does not match given number of summands.");
     return false;
   }
-  size_t seed=0;
-  size_t pow=1;
-  for(size_t i=0;i<I.clearTextLength;i++){
-    seed+= pow * I.clearText[i];
-    pow*=2;
-    if(pow!=pow){//overflow
-      pow=1;
-    }
+  bits.push_back(bit.result());
+  metrics().addSample("decryptBit",(wallTime()-bitStart)/1e6);
+  metrics().count("decrypt.monomials",readSummands);
+  return true;
+}
+
+/// stores the bits decrypted by decryptStream() as clear text, once
+/// their number matches the text length of the header
+bool storeStreamBits(state& I, const vector<bool>& bits){
+  if(bits.size() != I.clearTextLength){
+    LOG_ERROR("Read " << bits.size() << " encrypted bits, although text length should be " << I.clearTextLength);
+    return false;
+  }
+  I.clearText = new bool[bits.size()];
+  for(size_t i=0;i<bits.size();i++){
+    I.clearText[i]=bits[i];
   }
-  cout << "Salting clear text with " << I.salt<<endl;
-  //todo: this is not exactly a salted hash ;) -> currently relying on the rng seed() to do the hashing
-  seed = I.salt ^ seed;
-  I.r->seed(seed);
+  return true;
+}
 
-  I.cipher = new booleanFct<BFT_XOR>*[I.clearTextLength];
-  cout << "Sorting public key..."<<endl;
-  I.publicKey->recursiveSort();
+/// decryptStream() for binary ciphers
+bool decryptBinaryStream(state& I, mappedFile& file){
+  const char* p=file.begin();
+  cipherHeader header;
+  if(!readBinaryCipherHeader(header,p,file.end())){
+    return false;
+  }
+  I.setCipherHeader(header);
+  LOG_INFO("Reading binary cipher of length " << I.clearTextLength << " salt = " <<I.salt<< " encoder version = " << I.encoderVersion);
 
-  cout << "Starting encryption..."<<endl;
+  delete[] I.clearText;
+  I.clearText=0;
+
+  packedKey key(I.privateKey,I.n);
+  streamEvaluator bit(key);
+  vector<unsigned int> summand;
+  binaryANFReader in;
+  //grows with the decoded bits, the header length is not trusted
+  vector<bool> bits;
 
   for(size_t i=0;i<I.clearTextLength;i++){
-    I.cipher[i] = encrypt(I.r,I.n, I.publicKey, I.clearText[i], I.beta);
+    unsigned long long start=wallTime();
+    if(!in.begin(p,file.end())){
+      return false;
+    }
+    if(in.getNumberOfVars() > I.n){
+      LOG_ERROR("The cipher refers to " << in.getNumberOfVars() << " variables, but the private key has only " << I.n);
+      return false;
+    }
+    bit.reset();
+    summand.clear();
+    while(in.hasNext()){
+      if(!in.next(summand)){
+        LOG_ERROR("Error reading cipher.");
+        return false;
+      }
+      bit.addMonomial(summand.data(),summand.data()+summand.size());
+    }
+    bits.push_back(bit.result());
+    metrics().addSample("decryptBit",(wallTime()-start)/1e6);
+    metrics().count("decrypt.monomials",in.getNumberOfSummands());
+    p=in.position();
+    file.release(p);
+  }
+  if(p!=file.end()){
+    LOG_ERROR("More encrypted bits than the text length " << I.clearTextLength);
+    return false;
   }
-  cout <<"\n\t[OK]\tEncryption done"<<endl;
 
-  return true;
+  return storeStreamBits(I,bits);
 }
 
-bool decrypt(state& I){
-  if(I.cipher==0){
-    cerr <<"ERR: No cipher loaded!"<<endl;
+/// Decrypts the cipher file while reading it. Every summand is
+/// evaluated as soon as its line is parsed and the bit is known at the
+/// end of its section, so the cipher is never held in memory.
+bool decryptStream(state& I){
+  phaseTimer timer("decryptStream");
+  if(I.privateKey==0){
+    LOG_ERROR("No private key loaded!");
     return false;
   }
-  if(I.privateKey==0){
-    cerr <<"ERR: No private key loaded!"<<endl;
+
+  if(!I.batchMode){
+    string in;
+    cout << "Cipher file name (" << I.cipherFile <<"):";
+    getline(cin,in);
+    if(in.compare("")!=0){
+      I.cipherFile=in;
+    }
+  }
+
+  mappedFile file;
+  if (!file.open(I.cipherFile.c_str())){
+    LOG_ERROR("could not open file " << I.cipherFile << " for reading.");
     return false;
   }
 
-  I.clearText = new bool[I.clearTextLength];
-  cout << "Starting decryption..."<<endl;
+  LOG_INFO("Decrypting " << I.cipherFile << " while reading...");
+  clock_t start=clock();
 
-  for(size_t i=0;i<I.clearTextLength;i++){
-    I.clearText[i]= I.cipher[i]->evaluate(I.privateKey);
+  if(isBinaryCipher(file.begin(),file.end())){
+    if(!decryptBinaryStream(I,file)){
+      return false;
+    }
+    reportThroughput(file.size(),start);
+    LOG_INFO("done");
+    return true;
+  }
+
+  delete[] I.clearText;
+  I.clearText=0;
+
+  packedKey key(I.privateKey,I.n);
+  streamEvaluator bit(key);
+  vector<unsigned int> summand;
+  //grows with the decoded bits, the header length is not trusted
+  vector<bool> bits;
+
+  bool found=false;
+  //number of bits started so far
+  size_t i=0;
+  size_t vars=0;
+  size_t nbrSummands=0;
+  size_t readSummands=0;
+  unsigned long long bitStart=0;
+
+  dimacsScanner in(file.begin(),file.end());
+  const char *line, *lineEnd;
+  while(in.nextLine(line,lineEnd)){
+    if(!found){
+      cipherHeader header;
+      if(*line!='s' || !readCipherHeader(header,line,lineEnd)){
+        LOG_ERROR("File format error.");
+        return false;
+      }
+      I.setCipherHeader(header);
+      found=true;
+      LOG_INFO("Reading cipher of length " << I.clearTextLength << " salt = " <<I.salt<< " encoder version = " << I.encoderVersion);
+    }else if(*line=='p'){
+      if(i>0 && !finishStreamBit(I,bits,bit,nbrSummands,readSummands,bitStart)){
+        return false;
+      }
+      if(!readANFHeader(line,lineEnd,vars,nbrSummands)){
+        return false;
+      }
+      if(vars > I.n){
+        LOG_ERROR("The cipher refers to " << vars << " variables, but the private key has only " << I.n);
+        return false;
+      }
+      bit.reset();
+      readSummands=0;
+      bitStart=wallTime();
+      i++;
+      file.release(line);
+    }else{
+      if(i==0){
+        LOG_ERROR("File format error. Summand outside of an ANF.");
+        return false;
+      }
+      if(!readSummand(line,lineEnd,summand,vars)){
+        LOG_ERROR("Error reading cipher.");
+        return false;
+      }
+      bit.addMonomial(summand.data(),summand.data()+summand.size());
+      readSummands++;
+      if(readSummands%(1<<20)==0){
+        file.release(line);
+      }
+    }
+  }
+
+  if(i==0){
+    LOG_ERROR("Error reading cipher.");
+    return false;
+  }
+  if(!finishStreamBit(I,bits,bit,nbrSummands,readSummands,bitStart)){
+    return false;
+  }
+  if(!storeStreamBits(I,bits)){
+    return false;
   }
-  cout <<"done"<<endl;
+
+  reportThroughput(file.size(),start);
+  LOG_INFO("done");
 
   return true;
 }
@@ -408,50 +653,53 @@ bool decrypt(state& I){
 
 
 bool verifyCipher(state& I){
+  phaseTimer timer("verifyCipher");
   stringstream old;
   if(I.cipher==0){
-    cerr << "ERR: No cipher loaded!"<<endl;
+    LOG_ERROR("No cipher loaded!");
     return false;
   }
   if(I.clearText==0){
-    cerr << "ERR: No clear text loaded!"<<endl;
+    LOG_ERROR("No clear text loaded!");
     return false;
   }
   if(I.privateKey==0){
-    cerr << "ERR: No private key loaded!"<<endl;
+    LOG_ERROR("No private key loaded!");
     return false;
   }
 
-  cout << "saving current cipher"<<endl;
+  LOG_INFO("saving current cipher");
   old << "c Cipher"<<endl;
   old << "s "<<I.salt<<endl;
   bool re=true;
   for(size_t i=0;i<I.clearTextLength;i++){
-    re= re && writeANF(old, I.cipher[i]);
-    delete I.cipher[i];
+    re= re && writeANF(old, I.cipher[i], I.cipherVars);
   }
   delete[] I.cipher;
+  I.cipher=0;
 
   if(!re){
-    cerr << "Writing cipher failed!"<<endl;
+    LOG_ERROR("Writing cipher failed!");
     return false;
   }
 
-  cout << "Re-encrypting..."<<endl;
-  encrypt(I);
+  LOG_INFO("Re-encrypting...");
+  if(!encrypt(I)){
+    return false;
+  }
 
 
   stringstream newC;
 
-  cout << "Comparing..."<<endl;
+  LOG_INFO("Comparing...");
   newC << "c Cipher"<<endl;
   newC << "s "<<I.salt<<endl;
   for(size_t i=0;i<I.clearTextLength;i++){
-    re= re && writeANF(newC, I.cipher[i]);
+    re= re && writeANF(newC, I.cipher[i], I.cipherVars);
   }
 
   if(!re){
-    cerr << "Writing cipher failed!"<<endl;
+    LOG_ERROR("Writing cipher failed!");
     return false;
   }
 
@@ -460,76 +708,307 @@ bool verifyCipher(state& I){
   for (string line; getline(old, line); ) {
     getline(newC,newLine);
     if(line.compare(newLine)!=0){
-      cerr <<"\n\t[fail]\tMismatch!"<<endl;
+      LOG_ERROR("Encryptions do not match!");
       return false;
     }
   }
-  cout <<"\n\t[OK]\tEncryptions match."<<endl;
+  LOG_INFO("\n\t[OK]\tEncryptions match.");
 
   return true;
 }
 
 bool saveText(state& I){
+  phaseTimer timer("saveText");
   bool re = writeBool(I.outFile.c_str(),I.clearText, I.clearTextLength);
   if (re){
-    cout << "Wrote clear text to " << I.outFile <<endl;
+    LOG_INFO("Wrote clear text to " << I.outFile);
   }else{
-    cerr <<"ERR: Error clear text cipher."<<endl;
+    LOG_ERROR("Error clear text cipher.");
   }
   return re;
 }
 
 bool saveCipher(state& I){
-  ofstream out(I.outFile.c_str());
+  phaseTimer timer("saveCipher");
+  ofstream out(I.outFile.c_str(), ios::out | ios::binary);
   if (!out.good()){
-    cerr<< "ERR: could not open file " << I.outFile << " for writing." <<endl;
+    LOG_ERROR("could not open file " << I.outFile << " for writing.");
     return false;
   }
 
-  bool re=true;
-
-  out << "c Cipher"<<endl;
-  out << "c Format of the next line: 's salt textLength beta'"<<endl;
-  out << "s "<<I.salt<< " " << I.clearTextLength << " " << I.beta << endl << "c" <<endl;
-
-  for(size_t i=0;i<I.clearTextLength;i++){
-    out << "c ----------------------------------------"<<endl;
-    out << "c --------------next bit------------------"<<endl;
-    out << "c ----------------------------------------"<<endl;
-    re= re && writeANF(out, I.cipher[i]);
-  }
+  bool re=writeCipher(out, I.getCipherHeader(), I.cipher, I.cipherVars, I.binaryFormat);
 
   out.close();
   if (re){
-    cout << "Wrote cipher to " << I.outFile <<endl;
+    LOG_INFO("Wrote " << (I.binaryFormat ? "binary " : "") << "cipher to " << I.outFile);
   }else{
-    cerr <<"ERR: Error saving cipher."<<endl;
+    LOG_ERROR("Error saving cipher.");
   }
   return re;
 }
 
+/// Encrypts the clear text file clearFile ("-" for stdin) while
+/// reading it and writes every encrypted bit to outFile as soon as it
+/// is done. At most threads bits are in flight, hence memory does not
+/// depend on the text length. The text length in the header is
+/// patched at the end. Only the streaming encoder version can do
+/// this, cf. ENCODERVERSION: its ciphers can not be verified.
+bool encryptStream(state& I){
+  phaseTimer timer("encryptStream");
+  if(I.publicKey==0){
+    LOG_ERROR("No public key loaded!");
+    return false;
+  }
+  if(I.encoderVersion!=STREAMINGENCODERVERSION){
+    LOG_ERROR("Streaming encryption needs encoder version " << STREAMINGENCODERVERSION << ", not " << I.encoderVersion);
+    return false;
+  }
+
+  ifstream file;
+  if(I.clearFile!="-"){
+    file.open(I.clearFile.c_str(), ios::in | ios::binary);
+    if (!file.is_open()){
+      LOG_ERROR("could not open file " << I.clearFile << " for reading.");
+      return false;
+    }
+  }
+  boolReader text(I.clearFile=="-" ? cin : file);
+
+  ofstream out(I.outFile.c_str(), ios::out | ios::binary);
+  if (!out.good()){
+    LOG_ERROR("could not open file " << I.outFile << " for writing.");
+    return false;
+  }
+
+  delete[] I.clearText;
+  I.clearText=0;
+  delete[] I.cipher;
+  I.cipher=0;
+  I.cipherVars = I.n;
+  I.clearTextLength = 0;
+
+  streampos lengthPos;
+  if(!writeCipherHeader(out,I.getCipherHeader(),I.binaryFormat,&lengthPos)){
+    LOG_ERROR("Error saving cipher.");
+    return false;
+  }
+
+  LOG_INFO("Starting streaming encryption with " << I.threads << " threads...");
+
+  preparedPublicKey key(I.publicKey, I.n);
+  size_t window = I.threads;
+  bool* chunk = new bool[window];
+  //bit i is encrypted with the stream i of the secret
+  vector<size_t> seeds(window,streamSecret(I.r));
+  flatANF* cipher = new flatANF[window];
+  bool re=true;
+
+  while(re){
+    size_t length = text.read(chunk,window);
+    if(length==0){
+      break;
+    }
+    re = encrypt(I.r, seeds.data(), I.clearTextLength, key, chunk, length, I.beta, I.encoderVersion, I.threads, cipher);
+    for(size_t i=0;re && i<length;i++){
+      re = writeCipherBit(out, cipher[i], I.cipherVars, I.binaryFormat);
+      cipher[i].clear();
+    }
+    out.flush();
+    I.clearTextLength += length;
+  }
+  delete[] cipher;
+  delete[] chunk;
+
+  if(re && text.good() && I.clearTextLength==0){
+    LOG_ERROR("No clear text read from " << I.clearFile);
+    re=false;
+  }
+  re = re && text.good() && patchCipherLength(out,I.clearTextLength,I.binaryFormat,lengthPos);
+  out.close();
+  if(!re){
+    LOG_ERROR("Error in streaming encryption.");
+    return false;
+  }
+
+  LOG_INFO("\n\t[OK]\tEncrypted " << I.clearTextLength << " bits to " << I.outFile);
+  return true;
+}
+
 bool savePrivateKey(state& I){
-  bool re= writeBool(I.outFile.c_str(), I.privateKey, I.n);
+  phaseTimer timer("savePrivateKey");
+  bool re;
+  if(I.binaryFormat){
+    ofstream out(I.outFile.c_str(), ios::out | ios::binary);
+    re = out.good() && writeBinaryBool(out, I.privateKey, I.n);
+  }else{
+    re = writeBool(I.outFile.c_str(), I.privateKey, I.n);
+  }
   if (re){
-    cout << "Wrote private Key to " << I.outFile <<endl;
+    LOG_INFO("Wrote private Key to " << I.outFile);
   }else{
-    cerr <<"ERR: Error saving private key."<<endl;
+    LOG_ERROR("Error saving private key.");
   }
   return re;
 }
 
 bool savePublicKey(state& I){
-  bool re= writeCNF(I.outFile.c_str(), I.publicKey);
+  phaseTimer timer("savePublicKey");
+  bool re;
+  if(I.binaryFormat){
+    ofstream out(I.outFile.c_str(), ios::out | ios::binary);
+    re = out.good() && writeBinaryCNF(out, I.publicKey);
+  }else{
+    re = writeCNF(I.outFile.c_str(), I.publicKey);
+  }
   if (re){
-    cout << "Wrote public Key to " << I.outFile <<endl;
+    LOG_INFO("Wrote public Key to " << I.outFile);
+  }else{
+    LOG_ERROR("Error saving public key.");
+  }
+  return re;
+}
+
+
+/// Reads the file convertFile (in either format) and writes it to
+/// outFile in the format selected by binaryFormat.
+bool convert(state& I){
+  phaseTimer timer("convert");
+  I.batchMode=true;
+  bool re;
+  if(I.convertType=="pub"){
+    I.pubFile=I.convertFile;
+    re = readPublicKey(I) && savePublicKey(I);
+  }else if(I.convertType=="priv"){
+    I.privFile=I.convertFile;
+    re = readPrivateKey(I) && savePrivateKey(I);
+  }else if(I.convertType=="cipher"){
+    I.cipherFile=I.convertFile;
+    re = readCipher(I) && saveCipher(I);
   }else{
-    cerr <<"ERR: Error saving public key."<<endl;
+    LOG_ERROR("Unknown file type " << I.convertType << " to convert.");
+    return false;
+  }
+  if(!re){
+    LOG_ERROR("Conversion failed!");
   }
   return re;
 }
 
 
 
+/// Reads the (clear text, output) pairs of a batch: the lines
+/// "CLEARTEXTFILE OUTFILE" of the manifest batchFile, empty lines and
+/// lines starting with # are skipped. If batchFile is a directory, all
+/// regular files in it (but hidden ones) are taken in name order and
+/// written to outFile/NAME.
+bool readBatch(state& I, vector<batchMessage*>& messages){
+  struct stat info;
+  if(stat(I.batchFile.c_str(),&info)!=0){
+    LOG_ERROR("could not open " << I.batchFile << " for reading.");
+    return false;
+  }
+
+  vector<pair<string,string> > files;
+  if(S_ISDIR(info.st_mode)){
+    if(I.outFile==""){
+      LOG_ERROR("Encrypting a directory needs an output directory (-o).");
+      return false;
+    }
+    DIR* dir=opendir(I.batchFile.c_str());
+    if(dir==0){
+      LOG_ERROR("could not open directory " << I.batchFile << " for reading.");
+      return false;
+    }
+    vector<string> names;
+    for(struct dirent* entry=readdir(dir); entry!=0; entry=readdir(dir)){
+      string name(entry->d_name);
+      if(name[0]=='.'){
+        continue;
+      }
+      string path=I.batchFile+"/"+name;
+      if(stat(path.c_str(),&info)==0 && S_ISREG(info.st_mode)){
+        names.push_back(name);
+      }
+    }
+    closedir(dir);
+    sort(names.begin(),names.end());
+    for(size_t i=0;i<names.size();i++){
+      files.push_back(make_pair(I.batchFile+"/"+names[i],I.outFile+"/"+names[i]));
+    }
+  }else{
+    ifstream manifest(I.batchFile.c_str());
+    if(!manifest.good()){
+      LOG_ERROR("could not open " << I.batchFile << " for reading.");
+      return false;
+    }
+    string line;
+    for(size_t nbr=1;getline(manifest,line);nbr++){
+      stringstream ss(line);
+      string clear, out, rest;
+      if(!(ss >> clear) || clear[0]=='#'){
+        continue;
+      }
+      if(!(ss >> out) || (ss >> rest)){
+        LOG_ERROR("Line " << nbr << " of " << I.batchFile << " is not of the form CLEARTEXTFILE OUTFILE.");
+        return false;
+      }
+      files.push_back(make_pair(clear,out));
+    }
+  }
+
+  for(size_t i=0;i<files.size();i++){
+    batchMessage* message=new batchMessage();
+    messages.push_back(message);
+    message->clearFile=files[i].first;
+    message->outFile=files[i].second;
+    message->text=readBool(message->clearFile.c_str(),message->length);
+    if(message->text==0){
+      LOG_ERROR("Error reading text " << message->clearFile);
+      return false;
+    }
+    message->salt = I.saltGiven ? I.salt : I.r->getGoodSeed();
+  }
+  return true;
+}
+
+
+/// Encrypts all clear texts of batchFile with the public key pubFile,
+/// cf. encryptBatch(...).
+bool encryptBatch(state& I){
+  phaseTimer timer("batch");
+  I.batchMode=true;
+  if(I.encoderVersion<3 || I.encoderVersion>ENCODERVERSION || I.encoderVersion==STREAMINGENCODERVERSION){
+    LOG_ERROR("Batch encryption needs encoder version 3 to " << ENCODERVERSION << " but " << STREAMINGENCODERVERSION << ", not " << I.encoderVersion);
+    return false;
+  }
+  if(I.pubFile==""){
+    LOG_ERROR("Batch encryption needs a public key (-k).");
+    return false;
+  }
+  if(!readPublicKey(I)){
+    return false;
+  }
+
+  vector<batchMessage*> messages;
+  bool re=readBatch(I,messages);
+  if(re){
+    LOG_INFO("Encrypting " << messages.size() << " texts with " << I.threads << " threads...");
+    preparedPublicKey key(I.publicKey, I.n);
+    re=encryptBatch(I.r, key, messages, I.beta, I.encoderVersion, I.threads, I.binaryFormat);
+  }
+  for(size_t i=0;i<messages.size();i++){
+    delete messages[i];
+  }
+  if(!re){
+    LOG_ERROR("Batch encryption failed!");
+    return false;
+  }
+  LOG_INFO("\n\t[OK]\tBatch encryption done");
+  return true;
+}
+
+
+
 ///interactive mode
 int menu(state& I){
 
@@ -695,6 +1174,11 @@ int main(int args, char *arg[]){
       i++;
       I.m=atol(arg[i]);
       I.generateMode=true;
+    }else if(strcmp(arg[i],"-ks")==0){
+      i++;
+      I.keySeed=strtoull(arg[i],0,10);
+      I.keySeedGiven=true;
+      I.generateMode=true;
     }else if(strcmp(arg[i],"-k")==0){
       i++;
       I.pubFile=arg[i];
@@ -702,6 +1186,34 @@ int main(int args, char *arg[]){
       i++;
       I.cipherFile=arg[i];
       I.decryptMode=true;
+    }else if(strcmp(arg[i],"-f")==0){
+      i++;
+      if(i<args && strcmp(arg[i],"bin")==0){
+        I.binaryFormat=true;
+      }else if(i<args && strcmp(arg[i],"text")==0){
+        I.binaryFormat=false;
+      }else{
+        help();
+      }
+    }else if(strcmp(arg[i],"-convert")==0){
+      if(i+2>=args){
+        help();
+      }
+      I.convertType=arg[++i];
+      I.convertFile=arg[++i];
+    }else if(strcmp(arg[i],"-batch")==0){
+      i++;
+      if(i>=args){
+        help();
+      }
+      I.batchFile=arg[i];
+    }else if(strcmp(arg[i],"-v")==0){
+      I.verbosity++;
+    }else if(strcmp(arg[i],"-stream")==0){
+      I.streamMode=true;
+    }else if(strcmp(arg[i],"--metrics")==0 && i+1<args){
+      i++;
+      I.metricsFile=arg[i];
     }else if(strcmp(arg[i],"-t")==0){
       i++;
       I.clearFile=arg[i];
@@ -709,6 +1221,7 @@ int main(int args, char *arg[]){
     }else if(strcmp(arg[i],"-s")==0){
       i++;
       I.salt=atol(arg[i]);
+      I.saltGiven=true;
       /*    }else if(strcmp(arg[i],"-al")==0){
             i++;
             I.alpha=atol(arg[i]);
@@ -716,6 +1229,14 @@ int main(int args, char *arg[]){
     }else if(strcmp(arg[i],"-be")==0){
       i++;
       I.beta=atol(arg[i]);
+    }else if(strcmp(arg[i],"-ev")==0){
+      i++;
+      I.encoderVersion=atoi(arg[i]);
+      I.encoderVersionGiven=true;
+    }else if(strcmp(arg[i],"-j")==0){
+      i++;
+      int threads=atoi(arg[i]);
+      I.threads = threads<1 ? 1 : threads;
     }else if(strcmp(arg[i],"-o")==0){
       i++;
       I.outFile=arg[i];
@@ -729,6 +1250,21 @@ int main(int args, char *arg[]){
   // set m to default, if not specified
   I.checkM();
 
+  int level = (I.batchMode ? LOGLEVEL_WARN : LOGLEVEL_INFO) - (int)I.verbosity;
+  logLevel() = level<LOGLEVEL_DEBUG ? LOGLEVEL_DEBUG : level;
+
+  if(I.convertType!=""){
+    if(I.outFile==""){
+      LOG_ERROR("Converting needs an output file (-o).");
+      return -1;
+    }
+    return convert(I) ? 0 : -1;
+  }
+
+  if(I.batchFile!=""){
+    return encryptBatch(I) ? 0 : -1;
+  }
+
   if(!I.batchMode){
     cout << "kryptoSAT  Copyright (C) 2015 Sebastian E. Schmittner"<<endl;
     cout <<"This program comes with ABSOLUTELY NO WARRANTY."<<endl;
@@ -744,7 +1280,7 @@ int main(int args, char *arg[]){
   if(I.conflict()){
     cout << "Conflicting arguments encountered."<<endl;
     if(I.batchMode){
-      cerr << "ERR: Conflict in batch mode!"<<endl;
+      LOG_ERROR("Conflict in batch mode!");
       return -1;
     }
     cout << "I am not sure what to do. Entering menu."<<endl;
@@ -767,16 +1303,34 @@ int main(int args, char *arg[]){
     }
   }
 
-  if(I.encryptMode){
+  if(I.encryptMode && I.streamMode){
+    if(!I.generateMode){
+      readPublicKey(I);
+    }
+    if(I.outFile.compare("")==0){
+      LOG_ERROR("Streaming encryption needs an output file (-o).");
+      return -1;
+    }
+    if(!I.encoderVersionGiven){
+      I.encoderVersion=STREAMINGENCODERVERSION;
+    }
+    string ori(I.outFile);
+    I.outFile+=".cipher";
+    if(!encryptStream(I)){
+      LOG_ERROR("Encryption failed!");
+      return -1;
+    }
+    I.outFile=ori;
+  }else if(I.encryptMode){
     if(!I.generateMode){
       readPublicKey(I);
     }
     if(!readText(I)){
-      cerr << "ERR: Error reading text!"<<endl;
+      LOG_ERROR("Error reading text!");
       return menu(I);
     }
     if(!encrypt(I)){
-      cerr << "ERR: Encryption failed!"<<endl;
+      LOG_ERROR("Encryption failed!");
       return menu(I);
     }
     if(I.outFile.compare("")!=0){
@@ -790,16 +1344,23 @@ int main(int args, char *arg[]){
   }
   if(I.decryptMode){
     if(!readPrivateKey(I)){
-      cerr << "ERR: Error reading key!"<<endl;
-      return menu(I);
-    }
-    if(!readCipher(I)){
-      cerr << "ERR: Error reading cipher!"<<endl;
+      LOG_ERROR("Error reading key!");
       return menu(I);
     }
-    if(!decrypt(I)){
-      cerr << "ERR: Decryption failed!"<<endl;
-      return menu(I);
+    if(I.streamMode){
+      if(!decryptStream(I)){
+        LOG_ERROR("Decryption failed!");
+        return menu(I);
+      }
+    }else{
+      if(!readCipher(I)){
+        LOG_ERROR("Error reading cipher!");
+        return menu(I);
+      }
+      if(!decrypt(I)){
+        LOG_ERROR("Decryption failed!");
+        return menu(I);
+      }
     }
     if(I.outFile.compare("")!=0){
       string ori(I.outFile);
@@ -47,13 +47,25 @@
 #define KRYPTOSAT_H
 
 #include <cstring> //for size_t
+#include <thread>
+#include <atomic>
+#include <vector>
 
 
 #include "functionParser.h"
 #include "booleanFct.h"
+#include "flatCNF.h"
+#include "clauseSet.h"
 #include "rng.h"
 
 #include "encrypt.h"
+#include "decrypt.h"
+#include "cipherFormat.h"
+
+
+/// The parallel key generation draws its candidate clauses in blocks
+/// of this size, each block from its own random stream.
+#define KEYGENBLOCKSIZE 4096
 
 
 namespace kryptoSAT{
@@ -66,90 +78,308 @@ namespace kryptoSAT{
     return re;
   }
 
-  booleanFct<BFT_AND>* generatePublicKey(rng* r, const bool* privateKey, const size_t& privateKeyLength, const size_t& nbrClauses, const unsigned int& varsPerClause){
-
-    booleanFct<BFT_AND>* re = new booleanFct<BFT_AND>(privateKeyLength);
+  /// Draws a clause of varsPerClause distinct variables with random
+  /// signs into c, rerolling the signs until privateKey satisfies it
+  /// (planting). vars is scratch space of varsPerClause entries.
+  void drawPlantedClause(rng* r, const bool* privateKey, const size_t& privateKeyLength, const unsigned int& varsPerClause, vector<size_t>& vars, int* c){
+    for(size_t j=0;j<varsPerClause;j++){
+      bool varAccepted=false;
+      size_t var;
+      while(!varAccepted){
+        var = r->randomInt(privateKeyLength);
+        varAccepted=true;
+        // check for doubles
+        for(size_t k=0;k<j && varAccepted;k++){
+          if(vars[k]==var){varAccepted=false;continue;}
+        }
+      }
+      vars[j]=var;
+    }//next variable
 
-    while(re->size()<nbrClauses){
-      size_t* vars= new size_t[varsPerClause];
-      // generate random clause
+    //generate "signs" in place until the privateKey fullfills the
+    //clause (planting)
+    bool clauseAccepted=false;
+    while(!clauseAccepted){
       for(size_t j=0;j<varsPerClause;j++){
-        bool varAccepted=false;
-        size_t var;
-        while(!varAccepted){
-          var = r->randomInt(privateKeyLength);
-          varAccepted=true;
-          // check for doubles
-          for(size_t k=0;k<j && varAccepted;k++){
-            if(vars[k]==var){varAccepted=false;continue;}
-          }
-        }
-        vars[j]=var;
-      }//next variable
-
-      bool clauseAccepted=false;
-      while(!clauseAccepted){
-        booleanFct<BFT_OR> *c=new  booleanFct<BFT_OR>(privateKeyLength);
-
-        //generate data structure along with "signs"
-        for(size_t j=0;j<varsPerClause;j++){
-          if(r->randomBool()){
-            c->push_back(new booleanFct<BFT_INPUT>(privateKeyLength,vars[j]));
-          }else{
-            c->push_back(new booleanFct<BFT_NOT>(privateKeyLength,new booleanFct<BFT_INPUT>(privateKeyLength,vars[j])));
-          }
-        }
-        //planting, i.e. check if privateKey fullfills the clause, if not reroll signs:
-        if(!c->evaluate(privateKey)){
-          clauseAccepted=false;
-          //cleanup
-          c->disposeChildren();
-          delete c;
-          c=0;
+        if(r->randomBool()){
+          c[j]=vars[j]+1;
+          clauseAccepted = clauseAccepted || privateKey[vars[j]];
         }else{
-          clauseAccepted=true;
-
-          //check for doubles
-          bool found=false;
-          for(list<BF*>::iterator i=re->begin();i!=re->end() && !found;i++){
-            if(compare(*i,c)==0){
-              found=true;
-              continue;
-            }
-          }
-          if(!found){
-            re->push_back(c); //actually accept clause
-          }else{
-            //cleanup
-            c->disposeChildren();
-            delete c;
-            c=0;
-          }
+          c[j]=-(int)(vars[j]+1);
+          clauseAccepted = clauseAccepted || !privateKey[vars[j]];
         }
-      }//wend clause accept
+      }
+    }//wend clause accept
+  }
+
+
+  /// Generates nbrClauses random clauses with varsPerClause distinct
+  /// variables each, such that the privateKey satisfies all of
+  /// them. The result is in canonical (sorted) order.
+  flatCNF* generatePublicKey(rng* r, const bool* privateKey, const size_t& privateKeyLength, const size_t& nbrClauses, const unsigned int& varsPerClause){
+
+    flatCNF* re = new flatCNF(privateKeyLength);
+    re->reserve(nbrClauses,nbrClauses*varsPerClause);
+
+    vector<size_t> vars(varsPerClause);
+    vector<int> c(varsPerClause);
+    //the accepted clauses, for rejecting doubles
+    clauseSet known(re,nbrClauses);
+
+    while(re->size()<nbrClauses){
+      drawPlantedClause(r, privateKey, privateKeyLength, varsPerClause, vars, c.data());
+
+      //doubles are dropped, the next clause is drawn from scratch
+      if(!known.contains(c.data(),c.data()+c.size())){
+        re->addClause(c.data(),c.data()+c.size());
+        known.insert(re->size()-1);
+      }
 
-      delete[] vars;
     }//next clause
 
+    re->sort();
+
     return re;
   }
 
 
   /// the default is to use 3-SAT with with m = 2^3 *n clauses, where n is
   /// the number of variables, i.e. privateKeyLength
-  booleanFct<BFT_AND>* generatePublicKey(rng* r, const bool* privateKey, const size_t& privateKeyLength){
+  flatCNF* generatePublicKey(rng* r, const bool* privateKey, const size_t& privateKeyLength){
     return generatePublicKey(r, privateKey, privateKeyLength, 8*privateKeyLength,3);
   }
 
 
+  /// Private key of the key seed keySeed, drawn from its stream 0.
+  bool* generatePrivateKey(const rng* prototype, size_t keySeed, const size_t& length){
+    rng* r = prototype->spawn();
+    r->seed(keySeed,0);
+    bool* re = generatePrivateKey(r,length);
+    delete r;
+    return re;
+  }
+
+
+  /// Worker of the parallel generatePublicKey(): draws the candidate
+  /// clauses of the blocks taken from next until toBlock, block b from
+  /// the stream b+1 of keySeed. The literals of candidate i are
+  /// stored in canonical order at candidates[i*varsPerClause], its
+  /// clauseSet::hash() in hashes[i].
+  void keyCandidatesWorker(const rng* prototype, size_t keySeed, const bool* privateKey, size_t privateKeyLength, unsigned int varsPerClause, size_t toBlock, atomic<size_t>* next, int* candidates, size_t* hashes){
+    rng* r = prototype->spawn();
+    vector<size_t> vars(varsPerClause);
+    for(size_t b=(*next)++; b<toBlock; b=(*next)++){
+      r->seed(keySeed,b+1);
+      for(size_t i=b*KEYGENBLOCKSIZE;i<(b+1)*KEYGENBLOCKSIZE;i++){
+        int* c = candidates + i*varsPerClause;
+        drawPlantedClause(r, privateKey, privateKeyLength, varsPerClause, vars, c);
+        sort(c,c+varsPerClause,flatCNF::literalLess);
+        hashes[i] = clauseSet::hash(c,c+varsPerClause);
+      }
+    }
+    delete r;
+  }
+
+  /// Worker of the parallel generatePublicKey(): marks the candidates
+  /// in the given shard of the hashes, that equal a candidate with a
+  /// smaller index.
+  void keyDuplicatesWorker(const flatCNF* candidates, const size_t* hashes, unsigned int shard, unsigned int nbrShards, char* duplicate){
+    clauseSet known(candidates, candidates->size()/nbrShards+1);
+    for(size_t i=0;i<candidates->size();i++){
+      //the low bits of the hash select the slot within the shard
+      if((hashes[i]>>32)%nbrShards==shard && !known.insert(i)){
+        duplicate[i]=1;
+      }
+    }
+  }
+
+  /// Parallel version of generatePublicKey() for the key seed keySeed.
+  /// Candidate clauses are drawn in blocks of KEYGENBLOCKSIZE, block b
+  /// from the stream b+1 of keySeed, and the key consists of the
+  /// first nbrClauses distinct candidates. The result depends on the
+  /// seed only, not on nbrThreads. Clauses are compared as sets of
+  /// literals.
+  flatCNF* generatePublicKey(const rng* prototype, size_t keySeed, const bool* privateKey, const size_t& privateKeyLength, const size_t& nbrClauses, const unsigned int& varsPerClause, unsigned int nbrThreads){
+    if(nbrThreads<1){
+      nbrThreads=1;
+    }
+    vector<int> literals;
+    vector<size_t> hashes;
+    size_t nbrBlocks=0;
+    //a few spare candidates for the doubles
+    size_t wanted = nbrClauses + nbrClauses/16 + 1;
+
+    flatCNF* re = new flatCNF(privateKeyLength);
+    while(true){
+      size_t toBlock = (wanted+KEYGENBLOCKSIZE-1)/KEYGENBLOCKSIZE;
+      literals.resize(toBlock*KEYGENBLOCKSIZE*varsPerClause);
+      hashes.resize(toBlock*KEYGENBLOCKSIZE);
+
+      atomic<size_t> next(nbrBlocks);
+      vector<thread> workers;
+      for(unsigned int t=1;t<nbrThreads;t++){
+        workers.push_back(thread(keyCandidatesWorker, prototype, keySeed, privateKey, privateKeyLength, varsPerClause, toBlock, &next, literals.data(), hashes.data()));
+      }
+      keyCandidatesWorker(prototype, keySeed, privateKey, privateKeyLength, varsPerClause, toBlock, &next, literals.data(), hashes.data());
+      for(size_t t=0;t<workers.size();t++){
+        workers[t].join();
+      }
+      nbrBlocks=toBlock;
+
+      flatCNF candidates(privateKeyLength);
+      candidates.addClauses(literals.data(),hashes.size(),varsPerClause);
+      vector<char> duplicate(hashes.size(),0);
+      workers.clear();
+      for(unsigned int t=1;t<nbrThreads;t++){
+        workers.push_back(thread(keyDuplicatesWorker, &candidates, hashes.data(), t, nbrThreads, duplicate.data()));
+      }
+      keyDuplicatesWorker(&candidates, hashes.data(), 0, nbrThreads, duplicate.data());
+      for(size_t t=0;t<workers.size();t++){
+        workers[t].join();
+      }
+
+      re->clear();
+      re->reserve(nbrClauses,nbrClauses*varsPerClause);
+      for(size_t i=0;i<candidates.size() && re->size()<nbrClauses;i++){
+        if(!duplicate[i]){
+          re->addClause(candidates.clauseBegin(i),candidates.clauseEnd(i));
+        }
+      }
+      if(re->size()==nbrClauses){
+        break;
+      }
+      //too many doubles, draw further blocks
+      wanted = 2*nbrBlocks*KEYGENBLOCKSIZE;
+    }
+
+    re->sort(nbrThreads);
+
+    return re;
+  }
+
+
   /// By default chooses alpha=m and beta=3
-  booleanFct<BFT_XOR>* encrypt(rng * r,const size_t& privateKeyLength,const booleanFct<BFT_AND>* publicKey, const bool& input){
-    return encrypt(r,privateKeyLength, publicKey, input, 3);
+  bool encrypt(rng * r,const size_t& privateKeyLength,const flatCNF* publicKey, const bool& input, flatANF& cipher){
+    return encrypt(r,privateKeyLength, publicKey, input, 3, cipher);
   }
 
   //actual encoding in seperate header
 
 
+  /// 64 bit FNV-1a hash of the text (and its length), used to derive
+  /// the seed of the encryption from the salt
+  size_t hashText(const bool* text, const size_t& length){
+    unsigned long long h=14695981039346656037ULL;
+    for(size_t i=0;i<length;i++){
+      h = (h ^ (text[i] ? 1 : 0)) * 1099511628211ULL;
+    }
+    h = (h ^ length) * 1099511628211ULL;
+    return h;
+  }
+
+
+  /// Worker of encrypt(...,nbrThreads): takes the next bit until all are done
+  void encryptBitsWorker(const rng* prototype, const size_t* seeds, size_t offset, const preparedPublicKey* publicKey, const bool* text, size_t length, size_t beta, unsigned int encoderVersion, unsigned int windowThreads, atomic<size_t>* next, flatANF* cipher, atomic<bool>* success){
+    rng* r = spawnEncoderRNG(prototype,encoderVersion);
+    for(size_t i=(*next)++; i<length; i=(*next)++){
+      r->seed(seeds[i],offset+i);
+      if(!encrypt(r, *publicKey, text[i], beta, cipher[i], encoderVersion, windowThreads)){
+        *success=false;
+      }
+    }
+    delete r;
+  }
+
+  /// Encrypts length bits with independent random streams (encoder
+  /// version >= 3). The bits are the bits offset,...,offset+length-1
+  /// of a possibly longer text, bit i is encrypted with the stream
+  /// offset+i of seeds[i], hence the result does not depend on the
+  /// number of threads nor on how a text is split into calls. cipher
+  /// has to hold length entries. The generators are spawned from
+  /// prototype. Return indicates success.
+  /// The public key is prepared once by the caller and shared by all bits.
+  /// Threads not needed for the bits (short texts) are used inside
+  /// the bits, if the encoder version allows it.
+  bool encrypt(const rng* prototype, const size_t* seeds, size_t offset, const preparedPublicKey& publicKey, const bool* text, size_t length, const size_t& beta, unsigned int encoderVersion, unsigned int nbrThreads, flatANF* cipher){
+    if(nbrThreads<1){
+      nbrThreads=1;
+    }
+    unsigned int windowThreads=1;
+    if(nbrThreads>length){
+      if(length>0){
+        windowThreads=nbrThreads/length;
+      }
+      nbrThreads=length;
+    }
+
+    atomic<size_t> next(0);
+    atomic<bool> success(true);
+    vector<thread> workers;
+    for(unsigned int t=1;t<nbrThreads;t++){
+      workers.push_back(thread(encryptBitsWorker, prototype, seeds, offset, &publicKey, text, length, beta, encoderVersion, windowThreads, &next, cipher, &success));
+    }
+    encryptBitsWorker(prototype, seeds, offset, &publicKey, text, length, beta, encoderVersion, windowThreads, &next, cipher, &success);
+    for(size_t t=0;t<workers.size();t++){
+      workers[t].join();
+    }
+    return success;
+  }
+
+
+  /// Seeds of the bits of text for encrypt(prototype,seeds,...): the
+  /// salt XOR hashText(text) for every bit (encoder version >= 3, but
+  /// not the streaming one, cf. streamSecret()).
+  vector<size_t> textSeeds(size_t salt, const bool* text, size_t length, unsigned int encoderVersion){
+    return vector<size_t>(length, salt ^ hashText(text,length));
+  }
+
+  /// Seed of all bits of a streamed message (STREAMINGENCODERVERSION):
+  /// 64 bits from the entropy source of r. It is not stored anywhere,
+  /// hence a guess of the text can not be checked against the cipher
+  /// by encrypting it again (and neither can an honest encryption).
+  size_t streamSecret(rng* r){
+    return ((size_t)r->getGoodSeed() << 32) ^ r->getGoodSeed();
+  }
+
+
+  /// Encrypts the text of the given length into cipher[0..length),
+  /// seeded with the salt and the text as the encoder version
+  /// demands. The legacy version reseeds r and runs on one thread,
+  /// all later ones spawn threads generators from the prototype r.
+  bool encryptText(rng* r, const preparedPublicKey& publicKey, const bool* text, size_t length, size_t salt, size_t beta, unsigned int encoderVersion, unsigned int threads, flatANF* cipher){
+    if(encoderVersion==STREAMINGENCODERVERSION){
+      LOG_ERROR("Encoder version " << STREAMINGENCODERVERSION << " is only used for streaming encryption, its ciphers can not be encrypted again.");
+      return false;
+    }
+    if(encoderVersion==LEGACYENCODERVERSION){
+      size_t seed=0;
+      size_t pow=1;
+      for(size_t i=0;i<length;i++){
+        seed+= pow * text[i];
+        //wraps to 0 after 64 bits, i.e. only the first 64 bits count
+        //(the former check for overflow never fired)
+        pow*=2;
+      }
+      //todo: this is not exactly a salted hash ;) -> currently relying on the rng seed() to do the hashing
+      seed = salt ^ seed;
+      r->seed(seed);
+
+      LOG_INFO("Starting encryption...");
+
+      for(size_t i=0;i<length;i++){
+        if(!encrypt(r, publicKey, text[i], beta, cipher[i], encoderVersion)){
+          return false;
+        }
+      }
+      return true;
+    }
+
+    LOG_INFO("Starting encryption with " << threads << " threads...");
+    vector<size_t> seeds = textSeeds(salt, text, length, encoderVersion);
+    return encrypt(r, seeds.data(), 0, publicKey, text, length, beta, encoderVersion, threads, cipher);
+  }
+
+
 
 }//end namespace
 
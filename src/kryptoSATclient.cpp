@@ -0,0 +1,269 @@
+/*****************************************************************************
+ *
+ * @file kryptoSATclient.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Command line client of kryptoSATd for testing and scripting: sends
+ * one encrypt, decrypt, verify or stats request (optionally repeated
+ * and pipelined) over the Unix domain socket of the daemon and reports
+ * the answer and the latencies seen by the client.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+#include "functionParser.h"
+using namespace functionParser;
+
+#include "libkryptosat.h"
+#include "metrics.h"
+#include "daemonProtocol.h"
+
+using namespace daemonProtocol;
+
+
+
+void help(){
+  cout << "kryptoSATclient [-h] [-socket PATH=" << DAEMONSOCKET << "] [-key NAME] (-t CLEARTEXTFILE [-s SALT] [-be BETA=3] [-ev VERSION] [-f text|bin] | -c CIPHERFILE [-verify] | -stats) [-r REPEAT] [-o OUTFILE]"<<endl;
+  cout << "-h\tDisplay this help."<<endl;
+  cout << "-socket\tConnect to the daemon listening on PATH."<<endl;
+  cout << "-key\tUse the key pair served under NAME."<<endl;
+  cout << "-t\tEncrypt the clear text CLEARTEXTFILE with salt SALT (default: a random one), parameter BETA and encoder version VERSION (default: the current one) into the format chosen by -f."<<endl;
+  cout << "-c\tDecrypt the cipher CIPHERFILE, or with -verify check that it is an honest encryption."<<endl;
+  cout << "-stats\tPrint the latency statistics of the daemon as JSON."<<endl;
+  cout << "-r\tSend the request REPEAT times without waiting for the answers and print the latencies."<<endl;
+  cout << "-o\tWrite the cipher or clear text to OUTFILE instead of the standard output."<<endl;
+  cout <<endl;
+  exit(0);
+}
+
+/// Sends the request sent->size() times on fd and stores the send
+/// times in sent. On errors failed is set and the socket is shut down,
+/// which ends the reading of the answers.
+void sendRequests(int fd, unsigned int op, const string* key, const string* body, vector<atomic<unsigned long long> >* sent, atomic<bool>* failed){
+  for(size_t r=0;r<sent->size();r++){
+    (*sent)[r]=kryptoSAT::wallTime();
+    if(!writeFrame(fd,requestHeader(r,op,*key),body->data(),body->size())){
+      *failed=true;
+      shutdown(fd,SHUT_RDWR);
+      return;
+    }
+  }
+}
+
+
+int main(int args, char *arg[]){
+
+  string socketPath(DAEMONSOCKET);
+  string key;
+  string clearFile, cipherFile, outFile;
+  unsigned int op=0;
+  unsigned long long salt=0, beta=3, version=0;
+  bool saltGiven=false;
+  bool binaryFormat=false;
+  size_t repeat=1;
+
+  for(int i=1;i<args;i++){
+    if(strcmp(arg[i],"-socket")==0 && i+1<args){
+      socketPath=arg[++i];
+    }else if(strcmp(arg[i],"-key")==0 && i+1<args){
+      key=arg[++i];
+    }else if(strcmp(arg[i],"-t")==0 && i+1<args){
+      clearFile=arg[++i];
+      op=DAEMONOP_ENCRYPT;
+    }else if(strcmp(arg[i],"-c")==0 && i+1<args){
+      cipherFile=arg[++i];
+      if(op!=DAEMONOP_VERIFY){
+        op=DAEMONOP_DECRYPT;
+      }
+    }else if(strcmp(arg[i],"-verify")==0){
+      op=DAEMONOP_VERIFY;
+    }else if(strcmp(arg[i],"-stats")==0){
+      op=DAEMONOP_STATS;
+    }else if(strcmp(arg[i],"-s")==0 && i+1<args){
+      salt=strtoull(arg[++i],0,10);
+      saltGiven=true;
+    }else if(strcmp(arg[i],"-be")==0 && i+1<args){
+      beta=strtoull(arg[++i],0,10);
+    }else if(strcmp(arg[i],"-ev")==0 && i+1<args){
+      version=strtoull(arg[++i],0,10);
+    }else if(strcmp(arg[i],"-f")==0 && i+1<args){
+      binaryFormat = strcmp(arg[++i],"bin")==0;
+    }else if(strcmp(arg[i],"-r")==0 && i+1<args){
+      repeat=strtoull(arg[++i],0,10);
+    }else if(strcmp(arg[i],"-o")==0 && i+1<args){
+      outFile=arg[++i];
+    }else{
+      help();
+    }
+  }
+  if(op==0 || (op==DAEMONOP_VERIFY && cipherFile=="") || repeat<1){
+    help();
+  }
+
+  //body of the request
+  string body;
+  if(op==DAEMONOP_ENCRYPT){
+    size_t length;
+    bool* text=readBool(clearFile.c_str(),length);
+    if(text==0){
+      cerr << "ERR: Error reading text!"<<endl;
+      return -1;
+    }
+    putU64(body,salt);
+    putU8(body,saltGiven ? 1 : 0);
+    putU32(body,beta);
+    putU32(body,version);
+    putU8(body,binaryFormat ? libkryptosat::FORMAT_BINARY : libkryptosat::FORMAT_TEXT);
+    for(size_t i=0;i<length;i++){
+      putU8(body,text[i] ? 1 : 0);
+    }
+    delete[] text;
+  }else if(op!=DAEMONOP_STATS){
+    ifstream in(cipherFile.c_str(), ios::in | ios::binary);
+    if(!in.good()){
+      cerr << "ERR: could not open file " << cipherFile << " for reading." <<endl;
+      return -1;
+    }
+    body.assign((istreambuf_iterator<char>(in)),istreambuf_iterator<char>());
+  }
+
+  sockaddr_un address;
+  int fd=socket(AF_UNIX,SOCK_STREAM,0);
+  if(fd<0 || !socketAddress(socketPath,address) || connect(fd,(sockaddr*)&address,sizeof(address))!=0){
+    cerr << "ERR: could not connect to " << socketPath << ": " << strerror(errno) <<endl;
+    return -1;
+  }
+
+  //the requests are sent by a thread of their own while the answers
+  //are read, since the daemon stops reading from a connection with too
+  //many unanswered requests
+  vector<atomic<unsigned long long> > sent(repeat);
+  atomic<bool> sendFailed(false);
+  thread sender(sendRequests,fd,op,&key,&body,&sent,&sendFailed);
+
+  vector<double> latencies;
+  string payload, answer;
+  unsigned long long status=libkryptosat::STATUS_OK;
+  const char* error=0;
+  for(size_t r=0;r<repeat && error==0;r++){
+    if(!readFrame(fd,payload)){
+      error="Connection lost.";
+      break;
+    }
+    fieldReader in(payload.data(),payload.data()+payload.size());
+    unsigned long long id, s;
+    if(!in.getUnsigned(id,4) || !in.getUnsigned(s,1) || id>=repeat){
+      error="Malformed answer.";
+      break;
+    }
+    latencies.push_back((kryptoSAT::wallTime()-sent[id])/1e6);
+    if(id==0){
+      status=s;
+      answer.assign(in.position(),in.remaining());
+    }
+  }
+  if(error!=0){
+    //unblocks the sender
+    shutdown(fd,SHUT_RDWR);
+  }
+  sender.join();
+  close(fd);
+  if(sendFailed){
+    error="Sending request failed.";
+  }
+  if(error!=0){
+    cerr << "ERR: " << error <<endl;
+    return -1;
+  }
+
+  if(status!=libkryptosat::STATUS_OK){
+    cerr << "ERR: " << answer <<endl;
+    return -1;
+  }
+
+  if(repeat>1){
+    sort(latencies.begin(),latencies.end());
+    cerr << repeat << " requests, latency median " << latencies[latencies.size()/2] << " ms, p95 "
+         << latencies[(size_t)(0.95*(latencies.size()-1))] << " ms, max " << latencies.back() << " ms" <<endl;
+  }
+
+  ofstream file;
+  if(outFile!=""){
+    file.open(outFile.c_str(), ios::out | ios::binary);
+    if(!file.good()){
+      cerr << "ERR: could not open file " << outFile << " for writing." <<endl;
+      return -1;
+    }
+  }
+  ostream& out = outFile!="" ? file : cout;
+
+  if(op==DAEMONOP_DECRYPT){
+    vector<char> text(answer.begin(),answer.end());
+    bool* bits=new bool[text.size()];
+    for(size_t i=0;i<text.size();i++){
+      bits[i]=text[i]!=0;
+    }
+    writeBool(out,bits,text.size());
+    delete[] bits;
+  }else if(op==DAEMONOP_VERIFY){
+    bool honest = answer.size()==1 && answer[0]==1;
+    out << (honest ? "\t[OK]\tEncryptions match." : "\t[fail]\tEncryptions do not match!") <<endl;
+    return honest ? 0 : 1;
+  }else{
+    out.write(answer.data(),answer.size());
+  }
+  return out.good() ? 0 : -1;
+}
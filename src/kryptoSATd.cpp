@@ -0,0 +1,577 @@
+/*****************************************************************************
+ *
+ * @file kryptoSATd.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * KryptoSAT daemon: loads key pairs once, keeps them prepared in
+ * memory and serves encrypt, decrypt and verify requests over a Unix
+ * domain socket (cf. daemonProtocol.h).
+ *
+ * Every connection has a reader thread, which queues the requests it
+ * receives. A pool of workers answers them, hence several requests of
+ * one or more clients are in flight at the same time. A reader stops
+ * reading while DAEMONMAXQUEUED requests of its connection are not
+ * answered. The latency of
+ * every request, from its arrival to its answer, is recorded in the
+ * metrics and can be queried with a STATS request.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+#include "libkryptosat.h"
+#include "metrics.h"
+#include "log.h"
+#include "daemonProtocol.h"
+
+using namespace libkryptosat;
+using namespace kryptoSAT;
+using namespace daemonProtocol;
+
+
+/// requests of one connection that may wait for an answer
+#define DAEMONMAXQUEUED 8
+
+
+/// the listening socket, shut down by signals to end the accept loop
+static int listenSocket=-1;
+static volatile sig_atomic_t signalled=0;
+
+void onSignal(int){
+  signalled=1;
+  if(listenSocket>=0){
+    shutdown(listenSocket,SHUT_RDWR);
+  }
+}
+
+
+
+/// a key pair served under a name, the private key may be empty
+struct servedKey{
+  publicKey pub;
+  privateKey priv;
+};
+
+
+/// One client connection. Its socket is closed when the reader and
+/// all queued requests are done with it.
+class connection{
+
+protected:
+  int fd;
+  mutex writeLock;
+
+  mutex queuedLock;
+  condition_variable queuedFree;
+  /// requests read but not answered
+  unsigned int queued;
+
+public:
+
+  connection(int _fd):fd(_fd),queued(0){}
+
+  ~connection(){
+    close(fd);
+  }
+
+  int getSocket() const{return fd;}
+
+  bool respond(unsigned long id, status s, const char* body, size_t length){
+    lock_guard<mutex> guard(writeLock);
+    return writeFrame(fd,responseHeader(id,s),body,length);
+  }
+
+  bool respond(unsigned long id, status s, const string& body){
+    return respond(id,s,body.data(),body.size());
+  }
+
+  /// waits until less than DAEMONMAXQUEUED requests are unanswered and
+  /// reserves the place of the next one
+  void reserve(){
+    unique_lock<mutex> guard(queuedLock);
+    while(queued>=DAEMONMAXQUEUED){
+      queuedFree.wait(guard);
+    }
+    queued++;
+  }
+
+  /// frees the place of an answered request
+  void release(){
+    {
+      lock_guard<mutex> guard(queuedLock);
+      queued--;
+    }
+    queuedFree.notify_one();
+  }
+
+};
+
+
+/// a received request waiting for a worker
+struct job{
+  shared_ptr<connection> client;
+  string request;
+  /// wall time of arrival in ns
+  unsigned long long received;
+};
+
+
+
+class server{
+
+protected:
+  map<string,servedKey*> keys;
+
+  mutex queueLock;
+  condition_variable queueReady;
+  deque<job> queue;
+  bool stopping;
+  /// requests received but not answered
+  atomic<unsigned long long> inFlight;
+
+  mutex connectionsLock;
+  condition_variable connectionsClosed;
+  set<connection*> connections;
+
+
+  /// reads requests of client until it disconnects and queues them
+  void readRequests(shared_ptr<connection> client){
+    string request;
+    while(true){
+      client->reserve();
+      if(!readFrame(client->getSocket(),request)){
+        break;
+      }
+      job j;
+      j.client=client;
+      j.request.swap(request);
+      j.received=wallTime();
+      metrics().max("daemon.inFlight",++inFlight);
+      {
+        lock_guard<mutex> guard(queueLock);
+        queue.push_back(move(j));
+      }
+      queueReady.notify_one();
+    }
+    LOG_DEBUG("Connection closed");
+    lock_guard<mutex> guard(connectionsLock);
+    connections.erase(client.get());
+    connectionsClosed.notify_all();
+  }
+
+  void work(){
+    while(true){
+      job j;
+      {
+        unique_lock<mutex> guard(queueLock);
+        while(queue.empty() && !stopping){
+          queueReady.wait(guard);
+        }
+        if(queue.empty()){
+          return;
+        }
+        j=move(queue.front());
+        queue.pop_front();
+      }
+      metrics().addSample("daemon.queue",(wallTime()-j.received)/1e6);
+      handle(j);
+      j.client->release();
+      inFlight--;
+    }
+  }
+
+
+  /// serialises c in format f into re
+  static status serializeCipher(const cipher& c, format f, string& re){
+    size_t length;
+    status s=c.serialize(f,0,0,length);
+    if(s!=STATUS_BUFFER_TOO_SMALL && s!=STATUS_OK){
+      return s;
+    }
+    re.resize(length);
+    return c.serialize(f,length>0 ? &re[0] : 0,length,length);
+  }
+
+  status encryptRequest(const servedKey& key, fieldReader& in, string& out){
+    unsigned long long salt, saltGiven, beta, version, f;
+    if(!in.getUnsigned(salt,8) || !in.getUnsigned(saltGiven,1) || !in.getUnsigned(beta,4) || !in.getUnsigned(version,4) || !in.getUnsigned(f,1)){
+      out="malformed encrypt request";
+      return STATUS_INVALID_ARGUMENT;
+    }
+    encryptionParameters parameters;
+    parameters.salt=salt;
+    parameters.saltGiven=saltGiven!=0;
+    parameters.beta=beta;
+    parameters.encoderVersion=version;
+    cipher c;
+    status s=encrypt(key.pub,(const unsigned char*)in.position(),in.remaining(),parameters,c);
+    if(s!=STATUS_OK){
+      return s;
+    }
+    return serializeCipher(c,f==FORMAT_BINARY ? FORMAT_BINARY : FORMAT_TEXT,out);
+  }
+
+  status decryptRequest(const servedKey& key, fieldReader& in, string& out){
+    cipher c;
+    status s=c.parse(in.position(),in.remaining());
+    if(s!=STATUS_OK){
+      return s;
+    }
+    out.resize(c.size());
+    size_t written;
+    return decrypt(key.priv,c,(unsigned char*)(out.size()>0 ? &out[0] : 0),out.size(),written);
+  }
+
+  /// re-encrypts the decryption of the cipher with its parameters and compares
+  status verifyRequest(const servedKey& key, fieldReader& in, string& out){
+    cipher c;
+    status s=c.parse(in.position(),in.remaining());
+    if(s!=STATUS_OK){
+      return s;
+    }
+    vector<unsigned char> text(c.size());
+    size_t written;
+    s=decrypt(key.priv,c,text.data(),text.size(),written);
+    if(s!=STATUS_OK){
+      return s;
+    }
+    encryptionParameters parameters;
+    parameters.salt=c.getSalt();
+    parameters.saltGiven=true;
+    parameters.beta=c.getBeta();
+    parameters.encoderVersion=c.getEncoderVersion();
+    cipher again;
+    s=encrypt(key.pub,text.data(),text.size(),parameters,again);
+    string given, honest;
+    if(s==STATUS_OK){
+      s=serializeCipher(c,FORMAT_BINARY,given);
+    }
+    if(s==STATUS_OK){
+      s=serializeCipher(again,FORMAT_BINARY,honest);
+    }
+    if(s==STATUS_OK){
+      out.assign(1,(char)(given==honest ? 1 : 0));
+    }
+    return s;
+  }
+
+
+  /// answers the request of j
+  void handle(job& j){
+    fieldReader in(j.request.data(),j.request.data()+j.request.size());
+    unsigned long long id=0, op=0, keyLength=0;
+    string name;
+    if(!in.getUnsigned(id,4) || !in.getUnsigned(op,1) || !in.getUnsigned(keyLength,2) || !in.getString(name,keyLength)){
+      metrics().count("daemon.errors",1);
+      j.client->respond(id,STATUS_INVALID_ARGUMENT,"malformed request");
+      return;
+    }
+
+    string out;
+    status s=STATUS_OK;
+    string opName;
+    if(op==DAEMONOP_STATS){
+      opName="stats";
+      ostringstream json;
+      metrics().toJSON(json);
+      out=json.str();
+    }else{
+      map<string,servedKey*>::const_iterator key=keys.find(name);
+      if(op==DAEMONOP_ENCRYPT){
+        opName="encrypt";
+      }else if(op==DAEMONOP_DECRYPT){
+        opName="decrypt";
+      }else if(op==DAEMONOP_VERIFY){
+        opName="verify";
+      }
+      if(opName==""){
+        s=STATUS_INVALID_ARGUMENT;
+        out="unknown operation";
+      }else if(key==keys.end()){
+        s=STATUS_INVALID_ARGUMENT;
+        out="unknown key "+name;
+      }else if(op!=DAEMONOP_ENCRYPT && key->second->priv.empty()){
+        s=STATUS_INVALID_ARGUMENT;
+        out="no private key for "+name;
+      }else if(op==DAEMONOP_ENCRYPT){
+        s=encryptRequest(*key->second,in,out);
+      }else if(op==DAEMONOP_DECRYPT){
+        s=decryptRequest(*key->second,in,out);
+      }else{
+        s=verifyRequest(*key->second,in,out);
+      }
+    }
+
+    if(s==STATUS_OK && out.size() > DAEMONMAXFRAME-DAEMONRESPONSEHEADER){
+      s=STATUS_BUFFER_TOO_SMALL;
+      ostringstream message;
+      message << "response of " << out.size() << " bytes exceeds the frame limit of " << DAEMONMAXFRAME << " bytes";
+      out=message.str();
+    }
+    if(s!=STATUS_OK){
+      if(out==""){
+        out=statusMessage(s);
+      }
+      metrics().count("daemon.errors",1);
+      LOG_DEBUG("Request " << id << " failed: " << out);
+    }
+    j.client->respond(id,s,out);
+    if(opName!=""){
+      metrics().addSample("daemon."+opName,(wallTime()-j.received)/1e6);
+      metrics().count("daemon.requests."+opName,1);
+    }
+  }
+
+
+  static bool readFile(const string& file, string& content){
+    ifstream in(file.c_str(), ios::in | ios::binary);
+    if(!in.good()){
+      LOG_ERROR("could not open file " << file << " for reading.");
+      return false;
+    }
+    content.assign((istreambuf_iterator<char>(in)),istreambuf_iterator<char>());
+    return true;
+  }
+
+
+public:
+
+  server():stopping(false),inFlight(0){}
+
+  ~server(){
+    for(map<string,servedKey*>::iterator i=keys.begin();i!=keys.end();i++){
+      delete i->second;
+    }
+  }
+
+  /// loads and prepares the key pair name, privFile may be empty
+  bool addKey(const string& name, const string& pubFile, const string& privFile){
+    if(keys.count(name)>0){
+      LOG_ERROR("Key " << name << " given twice.");
+      return false;
+    }
+    phaseTimer timer("daemon.loadKey");
+    servedKey* key=new servedKey();
+    string content;
+    status s=STATUS_OK;
+    if(!readFile(pubFile,content) || (s=key->pub.parse(content.data(),content.size()))!=STATUS_OK){
+      LOG_ERROR("Error reading public key " << pubFile << (s!=STATUS_OK ? string(": ")+statusMessage(s) : string()));
+      delete key;
+      return false;
+    }
+    if(privFile!=""){
+      bool valid=false;
+      if(!readFile(privFile,content) || (s=key->priv.parse(content.data(),content.size()))!=STATUS_OK
+         || (s=checkKeyPair(key->pub,key->priv,valid))!=STATUS_OK || !valid){
+        LOG_ERROR("Error reading private key " << privFile << (s!=STATUS_OK ? string(": ")+statusMessage(s) : string(", invalid key pair")));
+        delete key;
+        return false;
+      }
+    }
+    keys[name]=key;
+    LOG_INFO("Loaded key " << name << " (n=" << key->pub.getNumberOfVars() << ", m=" << key->pub.size() << (privFile=="" ? ", encryption only)" : ")"));
+    return true;
+  }
+
+  size_t size() const{return keys.size();}
+
+  /// Serves the socket path with nbrWorkers workers until SIGINT or
+  /// SIGTERM. Returns false if the socket can not be opened.
+  bool run(const string& path, unsigned int nbrWorkers){
+    sockaddr_un address;
+    if(!socketAddress(path,address)){
+      LOG_ERROR("Socket path " << path << " is too long.");
+      return false;
+    }
+    listenSocket=socket(AF_UNIX,SOCK_STREAM,0);
+    unlink(path.c_str());
+    if(listenSocket<0 || bind(listenSocket,(sockaddr*)&address,sizeof(address))!=0 || listen(listenSocket,64)!=0){
+      LOG_ERROR("could not listen on " << path << ": " << strerror(errno));
+      return false;
+    }
+
+    struct sigaction action;
+    memset(&action,0,sizeof(action));
+    action.sa_handler=onSignal;
+    sigaction(SIGINT,&action,0);
+    sigaction(SIGTERM,&action,0);
+
+    vector<thread> workers;
+    for(unsigned int t=0;t<nbrWorkers;t++){
+      workers.push_back(thread(&server::work,this));
+    }
+    LOG_INFO("Serving " << keys.size() << " keys on " << path << " with " << nbrWorkers << " workers");
+
+    while(!signalled){
+      int fd=accept(listenSocket,0,0);
+      if(fd<0){
+        if(errno==EINTR || errno==ECONNABORTED){
+          continue;
+        }
+        if(!signalled){
+          LOG_ERROR("accept failed: " << strerror(errno));
+        }
+        break;
+      }
+      LOG_DEBUG("Connection accepted");
+      shared_ptr<connection> client(new connection(fd));
+      {
+        lock_guard<mutex> guard(connectionsLock);
+        connections.insert(client.get());
+      }
+      thread(&server::readRequests,this,client).detach();
+    }
+
+    LOG_INFO("Shutting down");
+    close(listenSocket);
+    unlink(path.c_str());
+    {
+      //wake up the readers and wait for them
+      unique_lock<mutex> guard(connectionsLock);
+      for(set<connection*>::iterator i=connections.begin();i!=connections.end();i++){
+        shutdown((*i)->getSocket(),SHUT_RD);
+      }
+      while(!connections.empty()){
+        connectionsClosed.wait(guard);
+      }
+    }
+    {
+      lock_guard<mutex> guard(queueLock);
+      stopping=true;
+    }
+    queueReady.notify_all();
+    for(size_t t=0;t<workers.size();t++){
+      workers[t].join();
+    }
+    return true;
+  }
+
+};
+
+
+
+void help(){
+  cout << "kryptoSATd [-h] [-socket PATH=" << DAEMONSOCKET << "] [-j WORKERS] -key NAME PUBLICKEYFILE [PRIVATEKEYFILE] [-key ...] [--metrics FILE] [-v]"<<endl;
+  cout << "-h\tDisplay this help."<<endl;
+  cout << "-socket\tListen on the Unix domain socket PATH."<<endl;
+  cout << "-j\tAnswer up to WORKERS requests at the same time (default: number of cores)."<<endl;
+  cout << "-key\tServe the key pair read from PUBLICKEYFILE and PRIVATEKEYFILE under NAME. Without private key only encryption is possible. May be given several times."<<endl;
+  cout << "--metrics\tWrite the latency statistics to FILE on shutdown (they can be queried with kryptoSATclient -stats at any time)."<<endl;
+  cout << "-v\tMore verbose output."<<endl;
+  cout << "The daemon runs until SIGINT or SIGTERM."<<endl;
+  cout <<endl;
+  exit(0);
+}
+
+
+int main(int args, char *arg[]){
+
+  string socketPath(DAEMONSOCKET);
+  string metricsFile;
+  unsigned int workers=thread::hardware_concurrency();
+  unsigned int verbosity=0;
+  //name, public and private key file of every -key
+  vector<string> keyArgs;
+
+  for(int i=1;i<args;i++){
+    if(strcmp(arg[i],"-socket")==0 && i+1<args){
+      socketPath=arg[++i];
+    }else if(strcmp(arg[i],"-j")==0 && i+1<args){
+      int threads=atoi(arg[++i]);
+      workers = threads<1 ? 1 : threads;
+    }else if(strcmp(arg[i],"-key")==0 && i+2<args){
+      keyArgs.push_back(arg[++i]);
+      keyArgs.push_back(arg[++i]);
+      keyArgs.push_back(i+1<args && arg[i+1][0]!='-' ? arg[++i] : "");
+    }else if(strcmp(arg[i],"--metrics")==0 && i+1<args){
+      metricsFile=arg[++i];
+    }else if(strcmp(arg[i],"-v")==0){
+      verbosity++;
+    }else{
+      help();
+    }
+  }
+  if(workers<1){
+    workers=1;
+  }
+  int level=LOGLEVEL_INFO-(int)verbosity;
+  logLevel() = level<LOGLEVEL_DEBUG ? LOGLEVEL_DEBUG : level;
+
+  server S;
+  for(size_t k=0;k<keyArgs.size();k+=3){
+    if(!S.addKey(keyArgs[k],keyArgs[k+1],keyArgs[k+2])){
+      return -1;
+    }
+  }
+  if(S.size()==0){
+    LOG_ERROR("No key given (-key).");
+    return -1;
+  }
+
+  if(!S.run(socketPath,workers)){
+    return -1;
+  }
+  if(metricsFile!=""){
+    metrics().save(metricsFile);
+  }
+  return 0;
+}
@@ -0,0 +1,629 @@
+/*****************************************************************************
+ *
+ * @file libkryptosat.cpp
+ *
+ * @section DESCRIPTION
+ *
+ * Implementation of libkryptosat, the C++ interface libkryptosat.h and
+ * the C interface libkryptosatC.h on top of the engine headers. All
+ * diagnostics of the engine are compiled out.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+//the library never writes to the console
+#define KRYPTOSAT_MIN_LOGLEVEL LOGLEVEL_NONE
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <new>
+
+using namespace std;
+
+#include "functionParser.h"
+#include "rng.h"
+#include "kryptoSAT.h"
+
+#include "libkryptosat.h"
+#include "libkryptosatC.h"
+
+
+
+namespace libkryptosat{
+
+
+  struct publicKey::data{
+    flatCNF* cnf;
+    kryptoSAT::preparedPublicKey* prepared;
+
+    /// takes ownership of _cnf
+    data(flatCNF* _cnf):cnf(_cnf),prepared(0){
+      try{
+        prepared = new kryptoSAT::preparedPublicKey(cnf,cnf->getNumberOfVars());
+      }catch(...){
+        delete cnf;
+        throw;
+      }
+    }
+
+    ~data(){
+      delete prepared;
+      delete cnf;
+    }
+  };
+
+  struct privateKey::data{
+    bool* key;
+    size_t n;
+
+    /// takes ownership of _key
+    data(bool* _key, size_t _n):key(_key),n(_n){}
+
+    ~data(){delete[] key;}
+  };
+
+  struct cipher::data{
+    kryptoSAT::cipherHeader header;
+    flatANF* bits;
+    size_t vars;
+
+    data():bits(0),vars(0){}
+
+    ~data(){delete[] bits;}
+  };
+
+
+  /// copies s to buffer[0..capacity), cf. publicKey::serialize()
+  static status copyOut(const string& s, char* buffer, size_t capacity, size_t& written){
+    written=s.size();
+    if(capacity<s.size() || (buffer==0 && s.size()>0)){
+      return STATUS_BUFFER_TOO_SMALL;
+    }
+    memcpy(buffer,s.data(),s.size());
+    return STATUS_OK;
+  }
+
+
+  const char* statusMessage(status s){
+    switch(s){
+    case STATUS_OK:
+      return "ok";
+    case STATUS_INVALID_ARGUMENT:
+      return "invalid argument";
+    case STATUS_FORMAT_ERROR:
+      return "format error";
+    case STATUS_BUFFER_TOO_SMALL:
+      return "buffer too small";
+    case STATUS_UNSUPPORTED_VERSION:
+      return "unsupported encoder version";
+    case STATUS_KEY_MISMATCH:
+      return "cipher and private key do not match";
+    case STATUS_OUT_OF_MEMORY:
+      return "out of memory";
+    case STATUS_FAILED:
+      return "failed";
+    }
+    return "unknown status";
+  }
+
+
+
+  publicKey::publicKey():d(0){}
+
+  publicKey::~publicKey(){delete d;}
+
+  publicKey::publicKey(publicKey&& key):d(key.d){key.d=0;}
+
+  publicKey& publicKey::operator=(publicKey&& key){
+    if(this!=&key){
+      delete d;
+      d=key.d;
+      key.d=0;
+    }
+    return *this;
+  }
+
+  size_t publicKey::getNumberOfVars() const{return d==0 ? 0 : d->cnf->getNumberOfVars();}
+
+  size_t publicKey::size() const{return d==0 ? 0 : d->cnf->size();}
+
+  status publicKey::parse(const char* buffer, size_t length){
+    delete d;
+    d=0;
+    if(buffer==0){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    try{
+      flatCNF* cnf = functionParser::readAnyCNF(buffer,buffer+length);
+      if(cnf==0){
+        return STATUS_FORMAT_ERROR;
+      }
+      d = new data(cnf);
+    }catch(const bad_alloc&){
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      return STATUS_FAILED;
+    }
+    return STATUS_OK;
+  }
+
+  status publicKey::serialize(format f, char* buffer, size_t capacity, size_t& written) const{
+    written=0;
+    if(d==0){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    try{
+      ostringstream out;
+      bool re = f==FORMAT_BINARY ? functionParser::writeBinaryCNF(out,d->cnf) : functionParser::writeCNF(out,d->cnf);
+      if(!re){
+        return STATUS_FAILED;
+      }
+      return copyOut(out.str(),buffer,capacity,written);
+    }catch(const bad_alloc&){
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      return STATUS_FAILED;
+    }
+  }
+
+
+
+  privateKey::privateKey():d(0){}
+
+  privateKey::~privateKey(){delete d;}
+
+  privateKey::privateKey(privateKey&& key):d(key.d){key.d=0;}
+
+  privateKey& privateKey::operator=(privateKey&& key){
+    if(this!=&key){
+      delete d;
+      d=key.d;
+      key.d=0;
+    }
+    return *this;
+  }
+
+  size_t privateKey::getNumberOfVars() const{return d==0 ? 0 : d->n;}
+
+  status privateKey::parse(const char* buffer, size_t length){
+    delete d;
+    d=0;
+    if(buffer==0){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    try{
+      size_t n=0;
+      bool* key = functionParser::readBool(buffer,buffer+length,n);
+      if(key==0){
+        return STATUS_FORMAT_ERROR;
+      }
+      d = new data(key,n);
+    }catch(const bad_alloc&){
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      return STATUS_FAILED;
+    }
+    return STATUS_OK;
+  }
+
+  status privateKey::serialize(format f, char* buffer, size_t capacity, size_t& written) const{
+    written=0;
+    if(d==0){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    try{
+      ostringstream out;
+      bool re = f==FORMAT_BINARY ? functionParser::writeBinaryBool(out,d->key,d->n) : functionParser::writeBool(out,d->key,d->n);
+      if(!re){
+        return STATUS_FAILED;
+      }
+      return copyOut(out.str(),buffer,capacity,written);
+    }catch(const bad_alloc&){
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      return STATUS_FAILED;
+    }
+  }
+
+
+
+  cipher::cipher():d(0){}
+
+  cipher::~cipher(){delete d;}
+
+  cipher::cipher(cipher&& c):d(c.d){c.d=0;}
+
+  cipher& cipher::operator=(cipher&& c){
+    if(this!=&c){
+      delete d;
+      d=c.d;
+      c.d=0;
+    }
+    return *this;
+  }
+
+  size_t cipher::size() const{return d==0 ? 0 : d->header.textLength;}
+
+  size_t cipher::getNumberOfVars() const{return d==0 ? 0 : d->vars;}
+
+  size_t cipher::getSalt() const{return d==0 ? 0 : d->header.salt;}
+
+  size_t cipher::getBeta() const{return d==0 ? 0 : d->header.beta;}
+
+  unsigned int cipher::getEncoderVersion() const{return d==0 ? 0 : d->header.encoderVersion;}
+
+  status cipher::parse(const char* buffer, size_t length){
+    delete d;
+    d=0;
+    if(buffer==0){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    data* c=0;
+    try{
+      c = new data();
+      if(!kryptoSAT::readCipher(buffer,buffer+length,c->header,c->bits,c->vars)){
+        delete c;
+        return STATUS_FORMAT_ERROR;
+      }
+    }catch(const bad_alloc&){
+      delete c;
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      delete c;
+      return STATUS_FAILED;
+    }
+    d=c;
+    return STATUS_OK;
+  }
+
+  status cipher::serialize(format f, char* buffer, size_t capacity, size_t& written) const{
+    written=0;
+    if(d==0){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    try{
+      ostringstream out;
+      if(!kryptoSAT::writeCipher(out,d->header,d->bits,d->vars,f==FORMAT_BINARY)){
+        return STATUS_FAILED;
+      }
+      return copyOut(out.str(),buffer,capacity,written);
+    }catch(const bad_alloc&){
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      return STATUS_FAILED;
+    }
+  }
+
+
+
+  status generateKeyPair(const keyParameters& parameters, publicKey& pub, privateKey& priv){
+    size_t n=parameters.n;
+    size_t m = parameters.m==0 ? 5*n : parameters.m;
+    unsigned int k=parameters.k;
+    if(n<1 || k<1 || k>n || k>=8*sizeof(int)-1){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    //there are binomial(n,k)*(2^k-1) different clauses satisfied by
+    //the private key, asking for more would never end
+    double clauses=(double)((1ULL<<k)-1);
+    for(unsigned int i=0;i<k && clauses<m;i++){
+      clauses = clauses*(n-i)/(i+1);
+    }
+    if(clauses<m){
+      return STATUS_INVALID_ARGUMENT;
+    }
+
+    privateKey::data* newPriv=0;
+    publicKey::data* newPub=0;
+    try{
+      mersenneTwisterRNG r;
+      size_t seed=parameters.seed;
+      if(!parameters.seedGiven){
+        seed = r.getGoodSeed() ^ ((size_t)r.getGoodSeed() << 32);
+      }
+      newPriv = new privateKey::data(kryptoSAT::generatePrivateKey(&r,seed,n),n);
+      newPub = new publicKey::data(kryptoSAT::generatePublicKey(&r,seed,newPriv->key,n,m,k,parameters.threads));
+    }catch(const bad_alloc&){
+      delete newPriv;
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      delete newPriv;
+      return STATUS_FAILED;
+    }
+    delete priv.d;
+    priv.d=newPriv;
+    delete pub.d;
+    pub.d=newPub;
+    return STATUS_OK;
+  }
+
+
+  status checkKeyPair(const publicKey& pub, const privateKey& priv, bool& valid){
+    valid=false;
+    if(pub.d==0 || priv.d==0){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    if(pub.d->cnf->getNumberOfVars()!=priv.d->n){
+      return STATUS_OK;
+    }
+    valid = pub.d->cnf->evaluate(priv.d->key);
+    return STATUS_OK;
+  }
+
+
+  status encrypt(const publicKey& pub, const unsigned char* text, size_t length, const encryptionParameters& parameters, cipher& out){
+    if(pub.d==0 || (text==0 && length>0)){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    unsigned int encoderVersion = parameters.encoderVersion==0 ? ENCODERVERSION : parameters.encoderVersion;
+    //the streaming version is not reproducible, cf. ENCODERVERSION
+    if(encoderVersion<LEGACYENCODERVERSION || encoderVersion>ENCODERVERSION || encoderVersion==STREAMINGENCODERVERSION){
+      return STATUS_UNSUPPORTED_VERSION;
+    }
+    if(!pub.d->prepared->validBeta(parameters.beta)){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    unsigned int threads = parameters.threads<1 ? 1 : parameters.threads;
+
+    cipher::data* c=0;
+    bool* bits=0;
+    try{
+      bits = new bool[length];
+      for(size_t i=0;i<length;i++){
+        bits[i] = text[i]!=0;
+      }
+      mersenneTwisterRNG r;
+      size_t salt = parameters.saltGiven ? parameters.salt : r.getGoodSeed();
+      c = new cipher::data();
+      c->header.salt=salt;
+      c->header.textLength=length;
+      c->header.beta=parameters.beta;
+      c->header.encoderVersion=encoderVersion;
+      c->vars=pub.d->cnf->getNumberOfVars();
+      c->bits=new flatANF[length];
+
+      if(!kryptoSAT::encryptText(&r, *pub.d->prepared, bits, length, salt, parameters.beta, encoderVersion, threads, c->bits)){
+        delete[] bits;
+        delete c;
+        return STATUS_FAILED;
+      }
+    }catch(const bad_alloc&){
+      delete[] bits;
+      delete c;
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      delete[] bits;
+      delete c;
+      return STATUS_FAILED;
+    }
+    delete[] bits;
+    delete out.d;
+    out.d=c;
+    return STATUS_OK;
+  }
+
+
+  status decrypt(const privateKey& priv, const cipher& c, unsigned char* text, size_t capacity, size_t& written){
+    written=0;
+    if(priv.d==0 || c.d==0){
+      return STATUS_INVALID_ARGUMENT;
+    }
+    if(c.d->vars > priv.d->n){
+      return STATUS_KEY_MISMATCH;
+    }
+    size_t length=c.d->header.textLength;
+    written=length;
+    if(capacity<length || (text==0 && length>0)){
+      return STATUS_BUFFER_TOO_SMALL;
+    }
+    try{
+      kryptoSAT::packedKey key(priv.d->key,priv.d->n);
+      for(size_t i=0;i<length;i++){
+        text[i] = kryptoSAT::evaluate(key,c.d->bits[i]) ? 1 : 0;
+      }
+    }catch(const bad_alloc&){
+      written=0;
+      return STATUS_OUT_OF_MEMORY;
+    }catch(...){
+      written=0;
+      return STATUS_FAILED;
+    }
+    return STATUS_OK;
+  }
+
+
+}//end namespace
+
+
+
+//------------------------------------------------------------------------
+// C interface
+//------------------------------------------------------------------------
+
+using namespace libkryptosat;
+
+struct ksPublicKey{
+  publicKey key;
+};
+
+struct ksPrivateKey{
+  privateKey key;
+};
+
+struct ksCipher{
+  cipher c;
+};
+
+
+const char* ksStatusMessage(int status){
+  return statusMessage((libkryptosat::status)status);
+}
+
+
+ksPublicKey* ksPublicKeyNew(void){
+  return new(nothrow) ksPublicKey();
+}
+
+void ksPublicKeyFree(ksPublicKey* key){
+  delete key;
+}
+
+int ksPublicKeyParse(ksPublicKey* key, const char* buffer, size_t length){
+  if(key==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  return key->key.parse(buffer,length);
+}
+
+int ksPublicKeySerialize(const ksPublicKey* key, int format, char* buffer, size_t capacity, size_t* written){
+  if(key==0 || written==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  return key->key.serialize(format==KS_FORMAT_BINARY ? FORMAT_BINARY : FORMAT_TEXT,buffer,capacity,*written);
+}
+
+size_t ksPublicKeyNumberOfVars(const ksPublicKey* key){
+  return key==0 ? 0 : key->key.getNumberOfVars();
+}
+
+size_t ksPublicKeySize(const ksPublicKey* key){
+  return key==0 ? 0 : key->key.size();
+}
+
+
+ksPrivateKey* ksPrivateKeyNew(void){
+  return new(nothrow) ksPrivateKey();
+}
+
+void ksPrivateKeyFree(ksPrivateKey* key){
+  delete key;
+}
+
+int ksPrivateKeyParse(ksPrivateKey* key, const char* buffer, size_t length){
+  if(key==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  return key->key.parse(buffer,length);
+}
+
+int ksPrivateKeySerialize(const ksPrivateKey* key, int format, char* buffer, size_t capacity, size_t* written){
+  if(key==0 || written==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  return key->key.serialize(format==KS_FORMAT_BINARY ? FORMAT_BINARY : FORMAT_TEXT,buffer,capacity,*written);
+}
+
+size_t ksPrivateKeyNumberOfVars(const ksPrivateKey* key){
+  return key==0 ? 0 : key->key.getNumberOfVars();
+}
+
+
+ksCipher* ksCipherNew(void){
+  return new(nothrow) ksCipher();
+}
+
+void ksCipherFree(ksCipher* c){
+  delete c;
+}
+
+int ksCipherParse(ksCipher* c, const char* buffer, size_t length){
+  if(c==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  return c->c.parse(buffer,length);
+}
+
+int ksCipherSerialize(const ksCipher* c, int format, char* buffer, size_t capacity, size_t* written){
+  if(c==0 || written==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  return c->c.serialize(format==KS_FORMAT_BINARY ? FORMAT_BINARY : FORMAT_TEXT,buffer,capacity,*written);
+}
+
+size_t ksCipherSize(const ksCipher* c){
+  return c==0 ? 0 : c->c.size();
+}
+
+
+int ksGenerateKeyPair(size_t n, size_t m, unsigned int k, unsigned long long seed, int seedGiven, unsigned int threads, ksPublicKey* pub, ksPrivateKey* priv){
+  if(pub==0 || priv==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  keyParameters parameters;
+  parameters.n=n;
+  parameters.m=m;
+  parameters.k=k;
+  parameters.seed=seed;
+  parameters.seedGiven=seedGiven!=0;
+  parameters.threads=threads;
+  return generateKeyPair(parameters,pub->key,priv->key);
+}
+
+int ksCheckKeyPair(const ksPublicKey* pub, const ksPrivateKey* priv, int* valid){
+  if(pub==0 || priv==0 || valid==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  bool re;
+  int s=checkKeyPair(pub->key,priv->key,re);
+  *valid = re ? 1 : 0;
+  return s;
+}
+
+int ksEncrypt(const ksPublicKey* pub, const unsigned char* text, size_t length, size_t salt, int saltGiven, size_t beta, unsigned int encoderVersion, unsigned int threads, ksCipher* out){
+  if(pub==0 || out==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  encryptionParameters parameters;
+  parameters.salt=salt;
+  parameters.saltGiven=saltGiven!=0;
+  parameters.beta=beta;
+  parameters.encoderVersion=encoderVersion;
+  parameters.threads=threads;
+  return encrypt(pub->key,text,length,parameters,out->c);
+}
+
+int ksDecrypt(const ksPrivateKey* priv, const ksCipher* c, unsigned char* text, size_t capacity, size_t* written){
+  if(priv==0 || c==0 || written==0){
+    return KS_INVALID_ARGUMENT;
+  }
+  return decrypt(priv->key,c->c,text,capacity,*written);
+}
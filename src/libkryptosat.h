@@ -0,0 +1,250 @@
+/*****************************************************************************
+ *
+ * @file libkryptosat.h
+ *
+ * @section DESCRIPTION
+ *
+ * Public C++ interface of libkryptosat, the embeddable KryptoSAT
+ * library: key generation, encryption, decryption and serialisation of
+ * keys and ciphers.
+ *
+ * All data goes through buffers owned by the caller. No call writes to
+ * the console or ends the process, errors are reported as status
+ * codes. Const objects can be shared between threads, every call only
+ * uses the objects passed to it. The C interface is libkryptosatC.h.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef LIBKRYPTOSAT_H
+#define LIBKRYPTOSAT_H
+
+#include <cstddef>
+
+
+#if defined(__GNUC__)
+#define LIBKRYPTOSAT_API __attribute__((visibility("default")))
+#else
+#define LIBKRYPTOSAT_API
+#endif
+
+
+namespace libkryptosat{
+
+
+  /// result of every library call
+  enum status{
+    STATUS_OK=0,
+    /// null pointers, empty objects or parameters out of range
+    STATUS_INVALID_ARGUMENT=1,
+    /// the data to parse is malformed
+    STATUS_FORMAT_ERROR=2,
+    /// the output buffer is too small, the size needed is reported
+    STATUS_BUFFER_TOO_SMALL=3,
+    STATUS_UNSUPPORTED_VERSION=4,
+    /// the cipher refers to more variables than the private key has
+    STATUS_KEY_MISMATCH=5,
+    STATUS_OUT_OF_MEMORY=6,
+    STATUS_FAILED=7
+  };
+
+  /// static description of s
+  LIBKRYPTOSAT_API const char* statusMessage(status s);
+
+  /// serialisation formats, either is detected when parsing
+  enum format{
+    FORMAT_TEXT=0,
+    FORMAT_BINARY=1
+  };
+
+
+  class publicKey;
+  class privateKey;
+  class cipher;
+
+  struct keyParameters{
+    /// private key length
+    size_t n;
+    /// number of clauses, 0 for the default 5n
+    size_t m;
+    /// literals per clause
+    unsigned int k;
+    /// the same seed gives the same key pair for any number of
+    /// threads, drawn at random unless seedGiven
+    unsigned long long seed;
+    bool seedGiven;
+    unsigned int threads;
+
+    keyParameters():n(1024),m(0),k(3),seed(0),seedGiven(false),threads(1){}
+  };
+
+  struct encryptionParameters{
+    /// drawn at random for every encryption unless saltGiven
+    size_t salt;
+    bool saltGiven;
+    /// at least 1, larger values make the random functions grow
+    /// exponentially and are rejected from a bound on
+    size_t beta;
+    /// 0 for the current encoder version, the streaming version
+    /// (5) gives STATUS_UNSUPPORTED_VERSION
+    unsigned int encoderVersion;
+    unsigned int threads;
+
+    encryptionParameters():salt(0),saltGiven(false),beta(3),encoderVersion(0),threads(1){}
+  };
+
+
+  LIBKRYPTOSAT_API status generateKeyPair(const keyParameters& parameters, publicKey& pub, privateKey& priv);
+
+  /// valid is set iff pub(priv)=1
+  LIBKRYPTOSAT_API status checkKeyPair(const publicKey& pub, const privateKey& priv, bool& valid);
+
+  /// Encrypts the length bits text[0..length), any non zero byte is a
+  /// one. Ciphers of encoder versions above 2 do not depend on the
+  /// number of threads.
+  LIBKRYPTOSAT_API status encrypt(const publicKey& pub, const unsigned char* text, size_t length, const encryptionParameters& parameters, cipher& out);
+
+  /// Decrypts c into text[0..c.size()) as bytes 0 and 1. capacity is
+  /// the size of text, written the number of bits (or the size needed).
+  LIBKRYPTOSAT_API status decrypt(const privateKey& priv, const cipher& c, unsigned char* text, size_t capacity, size_t& written);
+
+
+  /// Parsing and serialising is the same for all three kinds of
+  /// objects: parse() replaces the content by the data
+  /// [data,data+length), the object is left empty on errors.
+  /// serialize() writes to buffer[0..capacity) and sets written to
+  /// the bytes used. If the buffer is too small, nothing is written
+  /// and written is the size needed, i.e. serialize(f,0,0,written)
+  /// queries the size.
+  class publicKey{
+
+  public:
+    struct data;
+
+    LIBKRYPTOSAT_API publicKey();
+    LIBKRYPTOSAT_API ~publicKey();
+    LIBKRYPTOSAT_API publicKey(publicKey&& key);
+    LIBKRYPTOSAT_API publicKey& operator=(publicKey&& key);
+
+    publicKey(const publicKey&) = delete;
+    publicKey& operator=(const publicKey&) = delete;
+
+    bool empty() const{return d==0;}
+    LIBKRYPTOSAT_API size_t getNumberOfVars() const;
+    /// number of clauses
+    LIBKRYPTOSAT_API size_t size() const;
+
+    LIBKRYPTOSAT_API status parse(const char* buffer, size_t length);
+    LIBKRYPTOSAT_API status serialize(format f, char* buffer, size_t capacity, size_t& written) const;
+
+  private:
+    data* d;
+
+    friend status generateKeyPair(const keyParameters&, publicKey&, privateKey&);
+    friend status checkKeyPair(const publicKey&, const privateKey&, bool&);
+    friend status encrypt(const publicKey&, const unsigned char*, size_t, const encryptionParameters&, cipher&);
+  };
+
+
+  class privateKey{
+
+  public:
+    struct data;
+
+    LIBKRYPTOSAT_API privateKey();
+    LIBKRYPTOSAT_API ~privateKey();
+    LIBKRYPTOSAT_API privateKey(privateKey&& key);
+    LIBKRYPTOSAT_API privateKey& operator=(privateKey&& key);
+
+    privateKey(const privateKey&) = delete;
+    privateKey& operator=(const privateKey&) = delete;
+
+    bool empty() const{return d==0;}
+    LIBKRYPTOSAT_API size_t getNumberOfVars() const;
+
+    LIBKRYPTOSAT_API status parse(const char* buffer, size_t length);
+    LIBKRYPTOSAT_API status serialize(format f, char* buffer, size_t capacity, size_t& written) const;
+
+  private:
+    data* d;
+
+    friend status generateKeyPair(const keyParameters&, publicKey&, privateKey&);
+    friend status checkKeyPair(const publicKey&, const privateKey&, bool&);
+    friend status decrypt(const privateKey&, const cipher&, unsigned char*, size_t, size_t&);
+  };
+
+
+  class cipher{
+
+  public:
+    struct data;
+
+    LIBKRYPTOSAT_API cipher();
+    LIBKRYPTOSAT_API ~cipher();
+    LIBKRYPTOSAT_API cipher(cipher&& c);
+    LIBKRYPTOSAT_API cipher& operator=(cipher&& c);
+
+    cipher(const cipher&) = delete;
+    cipher& operator=(const cipher&) = delete;
+
+    bool empty() const{return d==0;}
+    /// number of encrypted bits
+    LIBKRYPTOSAT_API size_t size() const;
+    /// number of variables the encrypted bits refer to
+    LIBKRYPTOSAT_API size_t getNumberOfVars() const;
+    LIBKRYPTOSAT_API size_t getSalt() const;
+    LIBKRYPTOSAT_API size_t getBeta() const;
+    LIBKRYPTOSAT_API unsigned int getEncoderVersion() const;
+
+    LIBKRYPTOSAT_API status parse(const char* buffer, size_t length);
+    LIBKRYPTOSAT_API status serialize(format f, char* buffer, size_t capacity, size_t& written) const;
+
+  private:
+    data* d;
+
+    friend status encrypt(const publicKey&, const unsigned char*, size_t, const encryptionParameters&, cipher&);
+    friend status decrypt(const privateKey&, const cipher&, unsigned char*, size_t, size_t&);
+  };
+
+
+}//end namespace
+
+
+#endif
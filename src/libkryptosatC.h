@@ -0,0 +1,132 @@
+/*****************************************************************************
+ *
+ * @file libkryptosatC.h
+ *
+ * @section DESCRIPTION
+ *
+ * C interface of libkryptosat for calling KryptoSAT in process from
+ * other languages and runtimes. It is a thin layer over the C++
+ * interface libkryptosat.h with opaque handles, the same status codes
+ * and the same buffer conventions: output goes to buffers owned by the
+ * caller, a too small buffer gives KS_BUFFER_TOO_SMALL and the size
+ * needed in *written.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef LIBKRYPTOSATC_H
+#define LIBKRYPTOSATC_H
+
+#include <stddef.h>
+
+#if defined(__GNUC__)
+#define KS_API __attribute__((visibility("default")))
+#else
+#define KS_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/* status codes, as libkryptosat::status */
+#define KS_OK 0
+#define KS_INVALID_ARGUMENT 1
+#define KS_FORMAT_ERROR 2
+#define KS_BUFFER_TOO_SMALL 3
+#define KS_UNSUPPORTED_VERSION 4
+#define KS_KEY_MISMATCH 5
+#define KS_OUT_OF_MEMORY 6
+#define KS_FAILED 7
+
+/* serialisation formats */
+#define KS_FORMAT_TEXT 0
+#define KS_FORMAT_BINARY 1
+
+
+typedef struct ksPublicKey ksPublicKey;
+typedef struct ksPrivateKey ksPrivateKey;
+typedef struct ksCipher ksCipher;
+
+
+KS_API const char* ksStatusMessage(int status);
+
+/* Handles start empty and are released with the matching free
+   function (which accepts 0). New returns 0 if out of memory. */
+KS_API ksPublicKey* ksPublicKeyNew(void);
+KS_API void ksPublicKeyFree(ksPublicKey* key);
+KS_API int ksPublicKeyParse(ksPublicKey* key, const char* buffer, size_t length);
+KS_API int ksPublicKeySerialize(const ksPublicKey* key, int format, char* buffer, size_t capacity, size_t* written);
+KS_API size_t ksPublicKeyNumberOfVars(const ksPublicKey* key);
+KS_API size_t ksPublicKeySize(const ksPublicKey* key);
+
+KS_API ksPrivateKey* ksPrivateKeyNew(void);
+KS_API void ksPrivateKeyFree(ksPrivateKey* key);
+KS_API int ksPrivateKeyParse(ksPrivateKey* key, const char* buffer, size_t length);
+KS_API int ksPrivateKeySerialize(const ksPrivateKey* key, int format, char* buffer, size_t capacity, size_t* written);
+KS_API size_t ksPrivateKeyNumberOfVars(const ksPrivateKey* key);
+
+KS_API ksCipher* ksCipherNew(void);
+KS_API void ksCipherFree(ksCipher* c);
+KS_API int ksCipherParse(ksCipher* c, const char* buffer, size_t length);
+KS_API int ksCipherSerialize(const ksCipher* c, int format, char* buffer, size_t capacity, size_t* written);
+/* number of encrypted bits */
+KS_API size_t ksCipherSize(const ksCipher* c);
+
+/* m=0 for 5n clauses, the seed is drawn at random unless seedGiven */
+KS_API int ksGenerateKeyPair(size_t n, size_t m, unsigned int k, unsigned long long seed, int seedGiven, unsigned int threads, ksPublicKey* pub, ksPrivateKey* priv);
+
+/* *valid is set to 1 iff pub(priv)=1 */
+KS_API int ksCheckKeyPair(const ksPublicKey* pub, const ksPrivateKey* priv, int* valid);
+
+/* text holds one bit per byte, encoderVersion 0 for the current one (5, the streaming one, is refused),
+   the salt is drawn at random unless saltGiven */
+KS_API int ksEncrypt(const ksPublicKey* pub, const unsigned char* text, size_t length, size_t salt, int saltGiven, size_t beta, unsigned int encoderVersion, unsigned int threads, ksCipher* out);
+
+/* writes the ksCipherSize(c) bits to text as bytes 0 and 1 */
+KS_API int ksDecrypt(const ksPrivateKey* priv, const ksCipher* c, unsigned char* text, size_t capacity, size_t* written);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+/*****************************************************************************
+ *
+ * @file log.h
+ *
+ * @section DESCRIPTION
+ *
+ * Levelled logging. Diagnostics go through the LOG_* macros:
+ * statements below the compile time minimum level
+ * KRYPTOSAT_MIN_LOGLEVEL are removed entirely, the others are filtered
+ * by the runtime level logLevel(). Every statement is written as one
+ * line without flushing, DEBUG and INFO to cout, WARN and ERROR
+ * (prefixed) to cerr.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <mutex>
+#include <atomic>
+
+#define LOGLEVEL_DEBUG 0
+#define LOGLEVEL_INFO 1
+#define LOGLEVEL_WARN 2
+#define LOGLEVEL_ERROR 3
+#define LOGLEVEL_NONE 4
+
+/// log statements below this level are not compiled, e.g.
+/// PREFLAGS=-DKRYPTOSAT_MIN_LOGLEVEL=LOGLEVEL_WARN
+#ifndef KRYPTOSAT_MIN_LOGLEVEL
+#define KRYPTOSAT_MIN_LOGLEVEL LOGLEVEL_DEBUG
+#endif
+
+namespace kryptoSAT{
+
+
+  /// Runtime level, messages below it are dropped. Default is
+  /// LOGLEVEL_INFO.
+  inline std::atomic<int>& logLevel(){
+    static std::atomic<int> re(LOGLEVEL_INFO);
+    return re;
+  }
+
+  inline bool logEnabled(int level){
+    return level>=logLevel();
+  }
+
+
+  /// One log statement, collected and written as a whole when
+  /// destroyed, such that lines of different threads do not interleave.
+  class logLine{
+
+  protected:
+    int level;
+    std::ostringstream line;
+
+    static std::mutex& outputLock(){
+      static std::mutex re;
+      return re;
+    }
+
+  public:
+
+    logLine(int _level):level(_level){
+      if(level==LOGLEVEL_WARN){
+        line << "WARN: ";
+      }else if(level>=LOGLEVEL_ERROR){
+        line << "ERR: ";
+      }
+    }
+
+    std::ostream& stream(){return line;}
+
+    ~logLine(){
+      line << '\n';
+      std::lock_guard<std::mutex> guard(outputLock());
+      (level>=LOGLEVEL_WARN ? std::cerr : std::cout) << line.str() << std::flush;
+    }
+
+  };
+
+
+}//end namespace
+
+
+#define KRYPTOSAT_LOG(level,message)                                    \
+  do{                                                                   \
+    if((level)>=KRYPTOSAT_MIN_LOGLEVEL && kryptoSAT::logEnabled(level)){ \
+      kryptoSAT::logLine(level).stream() << message;                    \
+    }                                                                   \
+  }while(0)
+
+#define LOG_DEBUG(message) KRYPTOSAT_LOG(LOGLEVEL_DEBUG,message)
+#define LOG_INFO(message) KRYPTOSAT_LOG(LOGLEVEL_INFO,message)
+#define LOG_WARN(message) KRYPTOSAT_LOG(LOGLEVEL_WARN,message)
+#define LOG_ERROR(message) KRYPTOSAT_LOG(LOGLEVEL_ERROR,message)
+
+
+#endif
@@ -0,0 +1,270 @@
+/*****************************************************************************
+ *
+ * @file mappedFile.h
+ *
+ * @section DESCRIPTION
+ *
+ * Read only view of a whole input file, memory mapped if possible, and
+ * a scanner handing out the lines and integers of DIMACS like files as
+ * views into it, without copying or allocating.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+
+/// The content of a file as one read only buffer. Regular files are
+/// mapped into memory, anything else (pipes, ...) is read into a
+/// private buffer.
+class mappedFile{
+
+ protected:
+  const char* data;
+  size_t length;
+  bool mapped;
+  vector<char> buffer;
+
+ public:
+
+  mappedFile():data(0),length(0),mapped(false){}
+
+  mappedFile(const mappedFile&) = delete;
+  mappedFile& operator=(const mappedFile&) = delete;
+
+  ~mappedFile(){
+    close();
+  }
+
+  /// return indicates success
+  bool open(const char* file){
+    close();
+    int fd = ::open(file,O_RDONLY);
+    if(fd<0){
+      return false;
+    }
+    struct stat info;
+    if(fstat(fd,&info)==0 && S_ISREG(info.st_mode) && info.st_size>0){
+      void* m = mmap(0,info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+      if(m!=MAP_FAILED){
+        //the parsers read front to back, pages behind can be dropped
+        madvise(m,info.st_size,MADV_SEQUENTIAL);
+        data=(const char*)m;
+        length=info.st_size;
+        mapped=true;
+        ::close(fd);
+        return true;
+      }
+    }
+    //not mappable
+    char chunk[1<<16];
+    ssize_t r;
+    while((r=read(fd,chunk,sizeof(chunk)))>0){
+      buffer.insert(buffer.end(),chunk,chunk+r);
+    }
+    ::close(fd);
+    if(r<0){
+      buffer.clear();
+      return false;
+    }
+    data=buffer.data();
+    length=buffer.size();
+    return true;
+  }
+
+  void close(){
+    if(mapped){
+      munmap((void*)data,length);
+    }
+    vector<char>().swap(buffer);
+    data=0;
+    length=0;
+    mapped=false;
+  }
+
+  /// Hint that [begin(),upTo) will not be read again. Mapped pages
+  /// in there are dropped from memory (they are reloaded from the file
+  /// if touched after all), so a front to back scan keeps the resident
+  /// size bounded.
+  void release(const char* upTo){
+    if(!mapped){
+      return;
+    }
+    size_t page=sysconf(_SC_PAGESIZE);
+    size_t length=(upTo-data)/page*page;
+    if(length>0){
+      madvise((void*)data,length,MADV_DONTNEED);
+    }
+  }
+
+  const char* begin() const{return data;}
+  const char* end() const{return data+length;}
+  size_t size() const{return length;}
+
+};
+
+
+
+/// Splits a buffer into lines and tokens. Lines handed out by
+/// nextLine() are views [b,e) without the line break. Empty lines and
+/// comments (starting with 'c' or '#') are skipped. Tokens are
+/// separated by blanks (' ', '\t' or '\r').
+class dimacsScanner{
+
+ protected:
+  const char* pos;
+  const char* last;
+
+ public:
+
+  dimacsScanner(const char* begin, const char* end):pos(begin),last(end){}
+
+  /// start of the unconsumed part of the buffer
+  const char* position() const{return pos;}
+
+  /// next non empty, non comment line, false at the end of the buffer
+  bool nextLine(const char*& b, const char*& e){
+    while(pos<last){
+      b=pos;
+      e=(const char*)memchr(pos,'\n',last-pos);
+      if(e==0){
+        e=last;
+        pos=last;
+      }else{
+        pos=e+1;
+      }
+      if(e>b && *b!='c' && *b!='#'){
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// as nextLine(), but the line stays unconsumed
+  bool peekLine(const char*& b, const char*& e){
+    const char* old=pos;
+    bool re=nextLine(b,e);
+    pos=old;
+    return re;
+  }
+
+
+  static bool isBlank(const char& c){
+    return c==' ' || c=='\t' || c=='\r';
+  }
+
+  /// true iff only blanks remain in [p,e)
+  static bool atEnd(const char* p, const char* e){
+    while(p<e && isBlank(*p)){
+      p++;
+    }
+    return p==e;
+  }
+
+  /// reads the next token into [tb,te), false if there is none
+  static bool nextToken(const char*& p, const char* e, const char*& tb, const char*& te){
+    while(p<e && isBlank(*p)){
+      p++;
+    }
+    if(p==e){
+      return false;
+    }
+    tb=p;
+    while(p<e && !isBlank(*p)){
+      p++;
+    }
+    te=p;
+    return true;
+  }
+
+  /// true iff the next token is word
+  static bool nextTokenIs(const char*& p, const char* e, const char* word){
+    const char *tb, *te;
+    return nextToken(p,e,tb,te) && (size_t)(te-tb)==strlen(word) && strncmp(tb,word,te-tb)==0;
+  }
+
+  /// reads the next token as decimal integer with optional sign. False
+  /// if there is no token, it is not a number or out of range.
+  static bool readInt(const char*& p, const char* e, long& v){
+    const char *tb, *te;
+    if(!nextToken(p,e,tb,te)){
+      return false;
+    }
+    bool negative = (*tb=='-');
+    if(*tb=='-' || *tb=='+'){
+      tb++;
+    }
+    if(tb==te){
+      return false;
+    }
+    unsigned long x=0;
+    for(;tb<te;tb++){
+      unsigned int d = *tb-'0';
+      if(d>9 || x > ((unsigned long)LONG_MAX - d)/10){
+        return false;
+      }
+      x = 10*x + d;
+    }
+    v = negative ? -(long)x : (long)x;
+    return true;
+  }
+
+  /// as readInt(), but for non negative numbers
+  static bool readSize(const char*& p, const char* e, size_t& v){
+    long x;
+    if(!readInt(p,e,x) || x<0){
+      return false;
+    }
+    v=x;
+    return true;
+  }
+
+};
+
+
+#endif
@@ -0,0 +1,311 @@
+/*****************************************************************************
+ *
+ * @file metrics.h
+ *
+ * @section DESCRIPTION
+ *
+ * Metrics of a run: wall and CPU time per phase, latency histograms
+ * (e.g. per encrypted bit), counters and maxima (e.g. monomials before
+ * and after cancellation, peak ANF size). All recording is thread
+ * safe, the aggregates can be queried and dumped as JSON (--metrics
+ * FILE).
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <ctime>
+#include <chrono>
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+
+#include "log.h"
+
+using namespace std;
+
+namespace kryptoSAT{
+
+
+  /// ns of wall clock time since some fixed point
+  inline unsigned long long wallTime(){
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /// ns of CPU time of the calling thread
+  inline unsigned long long threadCPUTime(){
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID,&t);
+    return t.tv_sec*1000000000ULL + t.tv_nsec;
+  }
+
+  /// ns of CPU time of the process, i.e. of all its threads
+  inline unsigned long long processCPUTime(){
+    timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&t);
+    return t.tv_sec*1000000000ULL + t.tv_nsec;
+  }
+
+
+
+  /// Distribution of samples (in ms) in power of two buckets: bucket 0
+  /// holds samples below 1 us, bucket b those in [2^(b-1),2^b) us.
+  class histogram{
+
+  protected:
+    vector<size_t> buckets;
+    size_t count;
+    double sum;
+    double min;
+    double max;
+
+  public:
+
+    histogram():buckets(40,0),count(0),sum(0),min(0),max(0){}
+
+    void add(double ms){
+      double us=ms*1000;
+      size_t b=0;
+      while(b+1<buckets.size() && us>=(double)(1ULL<<b)){
+        b++;
+      }
+      buckets[b]++;
+      if(count==0 || ms<min){
+        min=ms;
+      }
+      if(count==0 || ms>max){
+        max=ms;
+      }
+      count++;
+      sum+=ms;
+    }
+
+    size_t getCount() const{return count;}
+    double getMean() const{return count>0 ? sum/count : 0;}
+    double getMin() const{return min;}
+    double getMax() const{return max;}
+
+    /// upper bound (in ms) of the bucket the quantile q lies in, at most the maximum
+    double quantile(double q) const{
+      size_t rank=(size_t)(q*count);
+      size_t seen=0;
+      for(size_t b=0;b<buckets.size();b++){
+        seen+=buckets[b];
+        if(seen>rank){
+          double bound=(1ULL<<b)/1000.0;
+          return bound<max ? bound : max;
+        }
+      }
+      return max;
+    }
+
+    void toJSON(ostream& out) const{
+      out << "{\"count\": " << count << ", \"mean_ms\": " << getMean() << ", \"min_ms\": " << min << ", \"max_ms\": " << max
+          << ", \"p50_ms\": " << quantile(0.5) << ", \"p95_ms\": " << quantile(0.95) << ", \"p99_ms\": " << quantile(0.99)
+          << ", \"buckets_us\": [";
+      //trailing empty buckets are left out, entry b is the bucket below 2^b us
+      size_t last=buckets.size();
+      while(last>0 && buckets[last-1]==0){
+        last--;
+      }
+      for(size_t b=0;b<last;b++){
+        out << buckets[b] << (b+1<last ? ", " : "");
+      }
+      out << "]}";
+    }
+
+  };
+
+
+  /// wall and CPU time spent in a phase over all its runs
+  struct phaseStats{
+    size_t count;
+    unsigned long long wall;
+    unsigned long long cpu;
+
+    phaseStats():count(0),wall(0),cpu(0){}
+  };
+
+
+  /// Aggregated metrics of the process, see metrics().
+  class metricsRegistry{
+
+  protected:
+    mutable mutex lock;
+    map<string,phaseStats> phases;
+    map<string,histogram> histograms;
+    map<string,unsigned long long> counters;
+    map<string,unsigned long long> maxima;
+
+  public:
+
+    /// adds one run of the phase name, times in ns. Phases only timed
+    /// in CPU time of the threads doing the work have wall=0.
+    void addPhase(const string& name, unsigned long long wall, unsigned long long cpu){
+      lock_guard<mutex> guard(lock);
+      phaseStats& p=phases[name];
+      p.count++;
+      p.wall+=wall;
+      p.cpu+=cpu;
+    }
+
+    void addSample(const string& name, double ms){
+      lock_guard<mutex> guard(lock);
+      histograms[name].add(ms);
+    }
+
+    void count(const string& name, unsigned long long x){
+      lock_guard<mutex> guard(lock);
+      counters[name]+=x;
+    }
+
+    void max(const string& name, unsigned long long x){
+      lock_guard<mutex> guard(lock);
+      unsigned long long& m=maxima[name];
+      if(x>m){
+        m=x;
+      }
+    }
+
+    phaseStats getPhase(const string& name) const{
+      lock_guard<mutex> guard(lock);
+      map<string,phaseStats>::const_iterator i=phases.find(name);
+      return i==phases.end() ? phaseStats() : i->second;
+    }
+
+    histogram getHistogram(const string& name) const{
+      lock_guard<mutex> guard(lock);
+      map<string,histogram>::const_iterator i=histograms.find(name);
+      return i==histograms.end() ? histogram() : i->second;
+    }
+
+    unsigned long long getCounter(const string& name) const{
+      lock_guard<mutex> guard(lock);
+      map<string,unsigned long long>::const_iterator i=counters.find(name);
+      return i==counters.end() ? 0 : i->second;
+    }
+
+    unsigned long long getMaximum(const string& name) const{
+      lock_guard<mutex> guard(lock);
+      map<string,unsigned long long>::const_iterator i=maxima.find(name);
+      return i==maxima.end() ? 0 : i->second;
+    }
+
+    void clear(){
+      lock_guard<mutex> guard(lock);
+      phases.clear();
+      histograms.clear();
+      counters.clear();
+      maxima.clear();
+    }
+
+    void toJSON(ostream& out) const{
+      lock_guard<mutex> guard(lock);
+      out << "{\n  \"phases\": {";
+      for(map<string,phaseStats>::const_iterator i=phases.begin();i!=phases.end();i++){
+        out << (i==phases.begin() ? "\n" : ",\n") << "    \"" << i->first << "\": {\"count\": " << i->second.count
+            << ", \"wall_ms\": " << i->second.wall/1e6 << ", \"cpu_ms\": " << i->second.cpu/1e6 << "}";
+      }
+      out << "\n  },\n  \"histograms\": {";
+      for(map<string,histogram>::const_iterator i=histograms.begin();i!=histograms.end();i++){
+        out << (i==histograms.begin() ? "\n" : ",\n") << "    \"" << i->first << "\": ";
+        i->second.toJSON(out);
+      }
+      out << "\n  },\n  \"counters\": {";
+      for(map<string,unsigned long long>::const_iterator i=counters.begin();i!=counters.end();i++){
+        out << (i==counters.begin() ? "\n" : ",\n") << "    \"" << i->first << "\": " << i->second;
+      }
+      out << "\n  },\n  \"maxima\": {";
+      for(map<string,unsigned long long>::const_iterator i=maxima.begin();i!=maxima.end();i++){
+        out << (i==maxima.begin() ? "\n" : ",\n") << "    \"" << i->first << "\": " << i->second;
+      }
+      out << "\n  }\n}\n";
+    }
+
+    bool save(const string& file) const{
+      ofstream out(file.c_str());
+      if(!out.good()){
+        LOG_ERROR("could not open file " << file << " for writing.");
+        return false;
+      }
+      toJSON(out);
+      return out.good();
+    }
+
+  };
+
+
+  /// The metrics of this process. Inline, such that programs linking
+  /// libkryptosat statically can use this header, too.
+  inline metricsRegistry& metrics(){
+    static metricsRegistry re;
+    return re;
+  }
+
+
+  /// Records the wall and process CPU time from its construction to
+  /// its destruction as one run of the phase name.
+  class phaseTimer{
+
+  protected:
+    string name;
+    unsigned long long wall;
+    unsigned long long cpu;
+
+  public:
+
+    phaseTimer(const string& _name):name(_name),wall(wallTime()),cpu(processCPUTime()){}
+
+    ~phaseTimer(){
+      metrics().addPhase(name,wallTime()-wall,processCPUTime()-cpu);
+    }
+
+  };
+
+
+}//end namespace
+
+
+#endif
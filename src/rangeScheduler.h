@@ -0,0 +1,140 @@
+/*****************************************************************************
+ *
+ * @file rangeScheduler.h
+ *
+ * @section DESCRIPTION
+ *
+ * Work stealing over a range of equally sized tasks: every thread
+ * starts with its own share of the indices and works through it from
+ * the front, threads out of work steal the back half of the share of
+ * another thread.
+ *
+ *
+ * @author  Sebastian Schmittner <sebastian@schmittner.pw>
+ *
+ * @version 1.0.2015-04-09
+ *
+ * @section Version number format
+ *
+ * The Version number is formatted as "M.S.D" where M is the major
+ * release branch (backward compatibility to all non-alpha releases of
+ * the same branch is guaranteed), S is the state of this release (0
+ * for alpha, 1 for beta, 2 for stable), and D is the date formatted
+ * as yyyy-mm-dd.)
+ *
+ *
+ * @copyright 2015 Sebastian Schmittner
+ *
+ * @section LICENSE
+ *
+ * This file is part of KryptoSAT.
+ *
+ * KryptoSAT is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * KryptoSAT is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KryptoSAT.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+
+
+
+
+
+#ifndef RANGESCHEDULER_H
+#define RANGESCHEDULER_H
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+
+
+/// Hands out the indices [0,size) to nbrThreads threads, each index
+/// exactly once. Thread t starts with the t-th contiguous share and
+/// takes its indices in ascending order, hence neighbouring indices
+/// tend to be done at about the same time. A thread whose share is
+/// used up steals the back half of the remaining share of another
+/// thread.
+class rangeScheduler{
+
+ protected:
+
+  struct share{
+    std::mutex lock;
+    size_t begin;
+    size_t end;
+  };
+
+  std::vector<share*> shares;
+  std::atomic<size_t> steals;
+
+ public:
+
+  rangeScheduler(size_t size, unsigned int nbrThreads):steals(0){
+    if(nbrThreads<1){
+      nbrThreads=1;
+    }
+    for(unsigned int t=0;t<nbrThreads;t++){
+      share* s=new share();
+      s->begin=size*t/nbrThreads;
+      s->end=size*(t+1)/nbrThreads;
+      shares.push_back(s);
+    }
+  }
+
+  ~rangeScheduler(){
+    for(size_t t=0;t<shares.size();t++){
+      delete shares[t];
+    }
+  }
+
+  /// number of successful steals so far
+  size_t getSteals() const{return steals;}
+
+  /// Next index i for thread t, false if all indices are taken.
+  bool next(unsigned int t, size_t& i){
+    share* own=shares[t];
+    {
+      std::lock_guard<std::mutex> guard(own->lock);
+      if(own->begin<own->end){
+        i=own->begin++;
+        return true;
+      }
+    }
+    //steal from the others, starting with the next thread
+    for(size_t k=1;k<shares.size();k++){
+      share* victim=shares[(t+k)%shares.size()];
+      size_t from, to;
+      {
+        std::lock_guard<std::mutex> guard(victim->lock);
+        if(victim->begin>=victim->end){
+          continue;
+        }
+        to=victim->end;
+        from=victim->begin+(victim->end-victim->begin)/2;
+        victim->end=from;
+      }
+      steals++;
+      //the first stolen index is taken right away, the rest becomes the own share
+      std::lock_guard<std::mutex> guard(own->lock);
+      own->begin=from+1;
+      own->end=to;
+      i=from;
+      return true;
+    }
+    return false;
+  }
+
+};
+
+
+#endif
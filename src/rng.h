@@ -49,6 +49,8 @@
 
 #include <cstring>//for size_t
 #include <random>
+
+#include "log.h"
 using namespace std;
 
 
@@ -67,6 +69,15 @@ class rng{
   /// encryption (and honest encryption checking).
   virtual void seed(size_t seed)=0;
 
+  /// Seed for the reproducible sub-stream number stream of seed.
+  /// Different streams are (pseudo) independent, which allows to split
+  /// work over several generators deterministically.
+  virtual void seed(size_t seed, size_t stream)=0;
+
+  /// A new, unseeded generator of the same kind, e.g. for another
+  /// thread.
+  virtual rng* spawn() const=0;
+
   virtual size_t getGoodSeed()=0;
 
 
@@ -78,6 +89,9 @@ class rng{
   /// distributed integer in [0,max)
   virtual size_t randomInt(size_t max)=0;
 
+  /// 64 independent, evenly distributed random bits
+  virtual unsigned long long randomBits()=0;
+
 };
 
 
@@ -96,16 +110,27 @@ class mersenneTwisterRNG : public virtual rng{
   }
 
   void randomise(size_t entropy){
-    cout << "randomised"<<endl;
+    LOG_DEBUG("randomised");
     engine.seed(rd() ^ entropy);
   }
 
   void seed(size_t seed){
-    cout << "seeded"<<endl;
+    LOG_DEBUG("seeded");
 
     engine.seed(seed);
   }
 
+  void seed(size_t seed, size_t stream){
+    unsigned long long s=seed;
+    unsigned long long t=stream;
+    seed_seq seq{(unsigned int)s, (unsigned int)(s>>32), (unsigned int)t, (unsigned int)(t>>32)};
+    engine.seed(seq);
+  }
+
+  rng* spawn() const{
+    return new mersenneTwisterRNG();
+  }
+
   mersenneTwisterRNG(){}
 
   size_t randomInt(size_t max){
@@ -119,6 +144,127 @@ class mersenneTwisterRNG : public virtual rng{
     return re;
   }
 
+  unsigned long long randomBits(){
+    unsigned long long re=engine();
+    return (re<<32) | engine();
+  }
+
+};
+
+
+
+/// Buffered front end to another generator: booleans are served from
+/// a pool of 64 bits, bounded integers by Lemire's multiply and
+/// reject method (on 32 bit halves of a word for bounds up to 2^32),
+/// all fed by randomBits() of the source. Draws
+/// differ from the ones of the source, hence this is a different
+/// generator (cf. encoder version 8). Owns the source.
+class pooledRNG : public virtual rng{
+
+ private:
+  rng* source;
+  unsigned long long pool;
+  unsigned int poolSize;
+  /// the unused upper half of the last word drawn for next32()
+  unsigned int half;
+  bool haveHalf;
+
+  __extension__ typedef unsigned __int128 uint128;
+
+  unsigned int next32(){
+    if(haveHalf){
+      haveHalf=false;
+      return half;
+    }
+    unsigned long long x=source->randomBits();
+    half=x>>32;
+    haveHalf=true;
+    return (unsigned int)x;
+  }
+
+  void clearPools(){
+    poolSize=0;
+    haveHalf=false;
+  }
+
+ public:
+
+  pooledRNG(rng* _source):source(_source),pool(0),poolSize(0),half(0),haveHalf(false){}
+
+  ~pooledRNG(){
+    delete source;
+  }
+
+  pooledRNG(const pooledRNG&) = delete;
+  pooledRNG& operator=(const pooledRNG&) = delete;
+
+  size_t getGoodSeed(){
+    return source->getGoodSeed();
+  }
+
+  void randomise(size_t entropy){
+    source->randomise(entropy);
+    clearPools();
+  }
+
+  void seed(size_t seed){
+    source->seed(seed);
+    clearPools();
+  }
+
+  void seed(size_t seed, size_t stream){
+    source->seed(seed,stream);
+    clearPools();
+  }
+
+  rng* spawn() const{
+    return new pooledRNG(source->spawn());
+  }
+
+  bool randomBool(){
+    if(poolSize==0){
+      pool=source->randomBits();
+      poolSize=64;
+    }
+    bool re = pool & 1;
+    pool >>= 1;
+    poolSize--;
+    return re;
+  }
+
+  size_t randomInt(size_t max){
+    if(max <= 0xFFFFFFFFULL){
+      unsigned int bound=max;
+      unsigned long long x = (unsigned long long)next32() * bound;
+      unsigned int low = (unsigned int)x;
+      if(low < bound){
+        unsigned int threshold = -bound % bound;
+        while(low < threshold){
+          x = (unsigned long long)next32() * bound;
+          low = (unsigned int)x;
+        }
+      }
+      return (size_t)(x >> 32);
+    }
+
+    unsigned long long bound=max;
+    uint128 x = (uint128)source->randomBits() * bound;
+    unsigned long long low = (unsigned long long)x;
+    if(low < bound){
+      //reject the first 2^64 % bound values for an even distribution
+      unsigned long long threshold = -bound % bound;
+      while(low < threshold){
+        x = (uint128)source->randomBits() * bound;
+        low = (unsigned long long)x;
+      }
+    }
+    return (size_t)(x >> 64);
+  }
+
+  unsigned long long randomBits(){
+    return source->randomBits();
+  }
+
 };
 
 #endif